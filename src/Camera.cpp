@@ -6,21 +6,17 @@
 #include "glm/gtc/matrix_transform.hpp"
 
 Camera::Camera(float t, float p, float r)
-	: theta(t), phi(p), radius(r), target(glm::vec3(0.0f, 0.0f, 0.0f))
+	: target(glm::vec3(0.0f, 0.0f, 0.0f)), theta(t), phi(p), radius(r), origin(0.0f)
 {
 }
 
 glm::mat4 Camera::getView()
 {
 	// Calculate the camera’s position in spherical coordinates
-	glm::vec3 eye = radius * glm::vec3(
-		std::cos(theta) * std::sin(phi),
-		std::sin(theta),
-		std::cos(theta) * std::cos(phi)
-	);
+	glm::vec3 eye = getPos();
 
 	// Use the 'target' member variable to look at a new location
-	glm::vec3 at = target;
+	glm::vec3 at = origin + target;
 	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
 
 	// Return the lookAt matrix
@@ -29,7 +25,7 @@ glm::mat4 Camera::getView()
 
 glm::vec3 Camera::getPos()
 {
-	return radius * glm::vec3(
+	return origin + radius * glm::vec3(
 		std::cos(theta) * std::sin(phi),
 		std::sin(theta),
 		std::cos(theta) * std::cos(phi)
@@ -68,3 +64,8 @@ void Camera::setTarget(const glm::vec3& newTarget)
 {
 	target = newTarget;
 }
+
+void Camera::move(const glm::vec3& delta)
+{
+	origin += delta;
+}
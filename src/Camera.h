@@ -19,12 +19,18 @@ public:
 	glm::vec3 getTarget();
 	void setTarget(const glm::vec3& newTarget);
 
+	// Moves the eye and the target together, the orbit is around
+	// getOrigin() instead of the world origin afterwards
+	void move(const glm::vec3& delta);
+	glm::vec3 getOrigin() const { return origin; }
+
 
 	glm::vec3 target;
 private:
 	float theta;
 	float phi;
 	float radius;
+	glm::vec3 origin; // offset of the eye and the target
 
 	// A new member variable that indicates where the camera should look.
 	
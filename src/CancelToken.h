@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+
+
+// Lets a long running job notice that a newer request made it obsolete. The
+// job is cancelled once the shared counter moves past the id it started with.
+// A default constructed token is never cancelled.
+class CancelToken {
+
+public:
+	CancelToken()
+		: latest(nullptr)
+		, id(0)
+	{}
+
+	CancelToken(const std::atomic<unsigned>& latest, unsigned id)
+		: latest(&latest)
+		, id(id)
+	{}
+
+	bool cancelled() const {
+		return latest != nullptr && latest->load(std::memory_order_relaxed) != id;
+	}
+
+private:
+	const std::atomic<unsigned>* latest;
+	unsigned id;
+};
@@ -0,0 +1,61 @@
+#include "ComputeProgram.h"
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "GLCompute.h"
+#include "Log.h"
+
+
+ComputeProgram::ComputeProgram(const std::string& computePath)
+	: programID()
+	, compute(computePath, GL_COMPUTE_SHADER)
+{
+	attach(*this, compute);
+	glLinkProgram(programID);
+
+	if (!checkAndLogLinkSuccess()) {
+		throw std::runtime_error("Compute shader did not link.");
+	}
+}
+
+
+bool ComputeProgram::recompile() {
+
+	try {
+		ComputeProgram newProgram(compute.getPath());
+		*this = std::move(newProgram);
+		return true;
+	}
+	catch (std::runtime_error&) {
+		Log::warn("SHADER_PROGRAM falling back to previous version of {}", compute.getPath());
+		return false;
+	}
+}
+
+
+void attach(ComputeProgram& cp, Shader& s) {
+	glAttachShader(cp.programID, s.shaderID);
+}
+
+
+bool ComputeProgram::checkAndLogLinkSuccess() const {
+
+	GLint success;
+
+	glGetProgramiv(programID, GL_LINK_STATUS, &success);
+	if (!success) {
+		GLint logLength;
+		glGetProgramiv(programID, GL_INFO_LOG_LENGTH, &logLength);
+		std::vector<char> log(logLength);
+		glGetProgramInfoLog(programID, logLength, NULL, log.data());
+
+		Log::error("SHADER_PROGRAM linking {}:\n{}", compute.getPath(), log.data());
+		return false;
+	}
+	else {
+		Log::info("SHADER_PROGRAM successfully compiled and linked {}", compute.getPath());
+		return true;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Shader.h"
+
+#include "GLHandles.h"
+
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+
+
+// Program with a single compute shader stage, needs GLCompute::available().
+// Throws like ShaderProgram when it doesn't compile or link.
+class ComputeProgram {
+
+public:
+	explicit ComputeProgram(const std::string& computePath);
+
+	// Rule of zero, the handles do the RAII for us
+
+	// Public interface
+	// Rebuilds from the same file, keeps the old program when that fails
+	bool recompile();
+	void use() const { glUseProgram(programID); }
+
+	void friend attach(ComputeProgram& cp, Shader& s);
+
+	operator GLuint() const {
+		return programID;
+	}
+
+private:
+	ShaderProgramHandle programID;
+
+	Shader compute;
+
+	bool checkAndLogLinkSuccess() const;
+};
@@ -0,0 +1,237 @@
+#include "ConfigWatcher.h"
+#include "Log.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+ConfigWatcher::ConfigWatcher(const std::string& configPath, const std::vector<std::string>& shaderPaths,
+	std::chrono::milliseconds debounce)
+	: debounce(debounce)
+	, latest(nullptr)
+	, shadersChanged(false)
+	, configDirty(false)
+	, shadersDirty(false)
+	, stopping(false)
+	, stopPipe{ -1, -1 }
+{
+	auto add = [this](const std::string& path, bool isConfig) {
+		std::filesystem::path file(path);
+		std::string directory = file.parent_path().string();
+		files.push_back({ path, directory.empty() ? "." : directory, file.filename().string(), isConfig });
+	};
+	add(configPath, true);
+	for (const std::string& path : shaderPaths) {
+		add(path, false);
+	}
+
+#ifdef __linux__
+	if (pipe2(stopPipe, O_CLOEXEC) != 0) {
+		stopPipe[0] = stopPipe[1] = -1;
+	}
+#endif
+	thread = std::thread(&ConfigWatcher::loop, this);
+}
+
+
+ConfigWatcher::~ConfigWatcher() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+#ifdef __linux__
+	if (stopPipe[1] >= 0) {
+		char byte = 0;
+		(void)!write(stopPipe[1], &byte, 1);
+	}
+#endif
+	thread.join();
+#ifdef __linux__
+	if (stopPipe[0] >= 0) {
+		close(stopPipe[0]);
+		close(stopPipe[1]);
+	}
+#endif
+	delete latest.exchange(nullptr);
+}
+
+
+bool ConfigWatcher::takeConfig(config& out) {
+	config* parsed = latest.exchange(nullptr, std::memory_order_acquire);
+	if (!parsed) {
+		return false;
+	}
+	out = *parsed;
+	delete parsed;
+	return true;
+}
+
+
+bool ConfigWatcher::takeShadersChanged() {
+	return shadersChanged.exchange(false, std::memory_order_relaxed);
+}
+
+
+void ConfigWatcher::loop() {
+	PROFILE_THREAD_NAME("config watcher");
+	if (!watchEvents()) {
+		watchPolling();
+	}
+}
+
+
+bool ConfigWatcher::watchEvents() {
+#ifdef __linux__
+	if (stopPipe[0] < 0) {
+		return false;
+	}
+	int events = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (events < 0) {
+		Log::warn("CONFIG_WATCHER inotify not available, polling the files");
+		return false;
+	}
+
+	// One watch per directory, a file replaced by a rename is a new file
+	// that a watch on the file itself would miss
+	std::vector<std::pair<int, std::string>> watches;
+	for (const WatchedFile& file : files) {
+		auto known = std::find_if(watches.begin(), watches.end(), [&](const std::pair<int, std::string>& watch) {
+			return watch.second == file.directory;
+		});
+		if (known != watches.end()) {
+			continue;
+		}
+		int watch = inotify_add_watch(events, file.directory.c_str(),
+			IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+		if (watch < 0) {
+			Log::warn("CONFIG_WATCHER can't watch {}, polling the files", file.directory);
+			close(events);
+			return false;
+		}
+		watches.emplace_back(watch, file.directory);
+	}
+
+	alignas(inotify_event) char buffer[4096];
+	while (true) {
+		int timeout = -1;
+		if (configDirty || shadersDirty) {
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(quietAt - std::chrono::steady_clock::now());
+			timeout = (int)std::max<long long>(left.count(), 0) + 1;
+		}
+
+		pollfd waitOn[2] = { { events, POLLIN, 0 }, { stopPipe[0], POLLIN, 0 } };
+		int ready = poll(waitOn, 2, timeout);
+		if (ready < 0 && errno != EINTR) {
+			// Changes noticed so far stay dirty and get published there
+			Log::warn("CONFIG_WATCHER waiting for changes failed: {}, polling the files", std::strerror(errno));
+			close(events);
+			return false;
+		}
+		if (stopping) {
+			break;
+		}
+
+		if (ready > 0 && (waitOn[0].revents & POLLIN)) {
+			ssize_t length;
+			while ((length = read(events, buffer, sizeof(buffer))) > 0) {
+				for (char* at = buffer; at < buffer + length; at += sizeof(inotify_event) + ((inotify_event*)at)->len) {
+					const inotify_event* event = (const inotify_event*)at;
+					// Events were dropped, any of the files may have changed
+					if (event->mask & IN_Q_OVERFLOW) {
+						for (const WatchedFile& file : files) {
+							changed(file);
+						}
+						continue;
+					}
+					auto watch = std::find_if(watches.begin(), watches.end(), [&](const std::pair<int, std::string>& entry) {
+						return entry.first == event->wd;
+					});
+					if (event->len == 0 || watch == watches.end()) {
+						continue;
+					}
+					for (const WatchedFile& file : files) {
+						if (file.directory == watch->second && file.name == event->name) {
+							changed(file);
+						}
+					}
+				}
+			}
+		}
+		publishIfQuiet();
+	}
+
+	close(events);
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+void ConfigWatcher::watchPolling() {
+	// Twice per debounce time, a change is noticed half of it late at most
+	const std::chrono::milliseconds interval = std::max(debounce / 2, std::chrono::milliseconds(10));
+
+	std::vector<std::filesystem::file_time_type> times(files.size());
+	std::error_code error;
+	for (size_t i = 0; i < files.size(); i++) {
+		times[i] = std::filesystem::last_write_time(files[i].path, error);
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!wake.wait_for(lock, interval, [this] { return stopping.load(); })) {
+		for (size_t i = 0; i < files.size(); i++) {
+			// A file that is missing for a moment keeps its old time
+			auto time = std::filesystem::last_write_time(files[i].path, error);
+			if (!error && time != times[i]) {
+				times[i] = time;
+				changed(files[i]);
+			}
+		}
+		publishIfQuiet();
+	}
+}
+
+
+void ConfigWatcher::changed(const WatchedFile& file) {
+	if (file.isConfig) {
+		configDirty = true;
+	}
+	else {
+		shadersDirty = true;
+	}
+	quietAt = std::chrono::steady_clock::now() + debounce;
+}
+
+
+void ConfigWatcher::publishIfQuiet() {
+	if (!(configDirty || shadersDirty) || std::chrono::steady_clock::now() < quietAt) {
+		return;
+	}
+
+	if (configDirty) {
+		// loadConfig() falls back to the defaults for a missing file, an
+		// editor may have it moved away for a moment
+		std::error_code error;
+		if (std::filesystem::exists(files[0].path, error)) {
+			config* parsed = new config(loadConfig(files[0].path));
+			delete latest.exchange(parsed, std::memory_order_acq_rel);
+		}
+		configDirty = false;
+	}
+	if (shadersDirty) {
+		shadersChanged.store(true, std::memory_order_relaxed);
+		shadersDirty = false;
+	}
+}
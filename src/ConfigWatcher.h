@@ -0,0 +1,79 @@
+#pragma once
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Watches the config file and the shader sources on a background thread, so
+// the render loop doesn't check them every frame.
+//
+// On Linux the watcher sleeps on inotify events for the directories the
+// files are in, which also catches editors that save by replacing the file.
+// Elsewhere, or when inotify isn't available, it compares modification
+// times a few times a second. Changes are only acted on once the files were
+// left alone for the debounce time, so a file still being written isn't
+// read half way. The config is parsed on the watcher thread and handed to
+// the render thread through an atomic pointer swap, takeConfig() never
+// blocks.
+class ConfigWatcher {
+
+public:
+	ConfigWatcher(const std::string& configPath, const std::vector<std::string>& shaderPaths,
+		std::chrono::milliseconds debounce = std::chrono::milliseconds(150));
+	~ConfigWatcher();
+
+	// The thread can't be copied or moved
+	ConfigWatcher(const ConfigWatcher&) = delete;
+	ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+	// The newest config parsed since the last call, false when the file
+	// didn't change
+	bool takeConfig(config& out);
+
+	// True once after one of the shader sources changed, the caller
+	// recompiles them on the GL thread
+	bool takeShadersChanged();
+
+private:
+	struct WatchedFile {
+		std::string path;
+		std::string directory;  // "." for files without one
+		std::string name;
+		bool isConfig;
+	};
+
+	std::vector<WatchedFile> files;
+	std::chrono::milliseconds debounce;
+
+	// Handed over to the render thread, owned by whoever swapped it out
+	std::atomic<config*> latest;
+	std::atomic<bool> shadersChanged;
+
+	// Changes seen but not acted on yet, watcher thread only
+	bool configDirty;
+	bool shadersDirty;
+	std::chrono::steady_clock::time_point quietAt;
+
+	std::thread thread;
+	std::atomic<bool> stopping;
+	std::mutex mutex;
+	std::condition_variable wake;   // stops the polling loop
+	int stopPipe[2];                // stops the inotify loop
+
+	void loop();
+	// False when inotify couldn't be set up, nothing was watched then
+	bool watchEvents();
+	void watchPolling();
+
+	// Marks file as changed and restarts the debounce time
+	void changed(const WatchedFile& file);
+	// Parses and hands over what changed once the debounce time is over
+	void publishIfQuiet();
+};
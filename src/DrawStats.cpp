@@ -0,0 +1,49 @@
+#include "DrawStats.h"
+
+#include "GLTessellation.h"
+
+
+namespace {
+	DrawStats::Frame current;
+	DrawStats::Frame last;
+}
+
+
+void DrawStats::beginFrame() {
+	last = current;
+	current = Frame();
+}
+
+
+void DrawStats::count(GLenum mode, size_t vertices) {
+	current.drawCalls++;
+	current.vertices += vertices;
+	switch (mode) {
+	case GL_TRIANGLES:
+		current.triangles += vertices / 3;
+		break;
+	case GL_POINTS:
+		current.points += vertices;
+		break;
+	case GL_PATCHES:
+		// The terrain patches are quads
+		current.patches += vertices / 4;
+		break;
+	default:
+		break;
+	}
+}
+
+
+void DrawStats::countMulti(GLenum mode, const GLsizei* counts, size_t ranges) {
+	size_t vertices = 0;
+	for (size_t i = 0; i < ranges; i++) {
+		vertices += (size_t)counts[i];
+	}
+	count(mode, vertices);
+}
+
+
+const DrawStats::Frame& DrawStats::lastFrame() {
+	return last;
+}
@@ -0,0 +1,35 @@
+#pragma once
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+
+//------------------------------------------------------------------------------
+// Draw calls and what they drew, counted on the GL thread between two calls
+// of beginFrame(). GPU_Geometry counts its own draws, code that calls
+// glDrawArrays directly counts them with count().
+//------------------------------------------------------------------------------
+
+
+namespace DrawStats {
+
+	struct Frame {
+		int drawCalls = 0;
+		size_t vertices = 0;   // vertices, or indices of indexed draws, submitted
+		size_t triangles = 0;
+		size_t points = 0;
+		size_t patches = 0;    // tessellation patches, the triangles are made on the GPU
+	};
+
+	// Makes the counts so far the last frame and starts over
+	void beginFrame();
+
+	// One draw call of count vertices or indices in mode
+	void count(GLenum mode, size_t vertices);
+	// One multi-draw call, counted as a single call
+	void countMulti(GLenum mode, const GLsizei* counts, size_t ranges);
+
+	// Counts of the frame before the last beginFrame()
+	const Frame& lastFrame();
+}
@@ -0,0 +1,56 @@
+#include "Frustum.h"
+
+
+Frustum::Frustum()
+{
+	// 0x + 0y + 0z + 1 >= 0 holds everywhere
+	for (glm::vec4& plane : planes) {
+		plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+
+Frustum::Frustum(const glm::mat4& m)
+{
+	// Rows of the matrix, glm stores columns
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++) {
+		row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+	}
+
+	// -w <= x, y, z <= w in clip space
+	planes[0] = row[3] + row[0]; // left
+	planes[1] = row[3] - row[0]; // right
+	planes[2] = row[3] + row[1]; // bottom
+	planes[3] = row[3] - row[1]; // top
+	planes[4] = row[3] + row[2]; // near
+	planes[5] = row[3] - row[2]; // far
+}
+
+
+Frustum::Containment Frustum::classify(glm::vec3 low, glm::vec3 high) const
+{
+	Containment result = Containment::Inside;
+
+	for (const glm::vec4& plane : planes) {
+		// Corners furthest along and against the plane normal
+		glm::vec3 positive(
+			plane.x >= 0.0f ? high.x : low.x,
+			plane.y >= 0.0f ? high.y : low.y,
+			plane.z >= 0.0f ? high.z : low.z
+		);
+		glm::vec3 negative(
+			plane.x >= 0.0f ? low.x : high.x,
+			plane.y >= 0.0f ? low.y : high.y,
+			plane.z >= 0.0f ? low.z : high.z
+		);
+
+		if (plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.0f) {
+			return Containment::Outside;
+		}
+		if (plane.x * negative.x + plane.y * negative.y + plane.z * negative.z + plane.w < 0.0f) {
+			result = Containment::Intersects;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+
+// The six clip planes of a view volume, used to skip terrain that can't end
+// up on screen. Planes point inwards and aren't normalized, which is enough
+// for the side tests.
+class Frustum {
+
+public:
+	enum class Containment {
+		Outside,
+		Intersects,
+		Inside
+	};
+
+	// Everything passes until the frustum is set from a matrix
+	Frustum();
+
+	// Planes of projection * view (* model), in the space that matrix takes
+	// points from (Gribb and Hartmann)
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	// Axis aligned box from low to high
+	Containment classify(glm::vec3 low, glm::vec3 high) const;
+	bool intersects(glm::vec3 low, glm::vec3 high) const { return classify(low, high) != Containment::Outside; }
+
+private:
+	glm::vec4 planes[6];
+};
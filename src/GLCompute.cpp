@@ -0,0 +1,85 @@
+#include "GLCompute.h"
+#include "Log.h"
+
+#include <cstring>
+
+
+namespace {
+	typedef void (*DispatchComputeProc)(GLuint x, GLuint y, GLuint z);
+	typedef void (*MemoryBarrierProc)(GLbitfield barriers);
+
+	DispatchComputeProc dispatchCompute = nullptr;
+	MemoryBarrierProc memoryBarrierProc = nullptr;
+	GLint64 maxBlockSize = 0;
+
+	bool hasExtension(const char* wanted) {
+		GLint extensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+		for (GLint i = 0; i < extensions; i++) {
+			const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (name != nullptr && std::strcmp(name, wanted) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+
+bool GLCompute::load() {
+	dispatchCompute = nullptr;
+	memoryBarrierProc = nullptr;
+	maxBlockSize = 0;
+
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool supported = major > 4 || (major == 4 && minor >= 3);
+
+	// Drivers that stay below 4.3 may still expose both as extensions
+	if (!supported) {
+		supported = hasExtension("GL_ARB_compute_shader") && hasExtension("GL_ARB_shader_storage_buffer_object");
+	}
+	if (!supported) {
+		Log::info("COMPUTE not supported by this context, generating on the CPU");
+		return false;
+	}
+
+	DispatchComputeProc dispatch = (DispatchComputeProc)glfwGetProcAddress("glDispatchCompute");
+	MemoryBarrierProc barrier = (MemoryBarrierProc)glfwGetProcAddress("glMemoryBarrier");
+	if (dispatch == nullptr || barrier == nullptr) {
+		Log::warn("COMPUTE glDispatchCompute or glMemoryBarrier missing, generating on the CPU");
+		return false;
+	}
+	dispatchCompute = dispatch;
+	memoryBarrierProc = barrier;
+
+	glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+	Log::info("COMPUTE available, max storage block {} MB", maxBlockSize / (1024 * 1024));
+	return true;
+}
+
+
+bool GLCompute::available() {
+	return dispatchCompute != nullptr;
+}
+
+
+void GLCompute::dispatch(GLuint x, GLuint y, GLuint z) {
+	if (dispatchCompute != nullptr) {
+		dispatchCompute(x, y, z);
+	}
+}
+
+
+void GLCompute::memoryBarrier(GLbitfield barriers) {
+	if (memoryBarrierProc != nullptr) {
+		memoryBarrierProc(barriers);
+	}
+}
+
+
+GLint64 GLCompute::maxStorageBlockSize() {
+	return maxBlockSize;
+}
@@ -0,0 +1,55 @@
+#pragma once
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+//------------------------------------------------------------------------------
+// Compute shaders and shader storage buffers are core in OpenGL 4.3, beyond
+// the 3.3 core profile the GL loader is generated for. Like GLTessellation,
+// the enums and entry points the GPU terrain generator needs are declared
+// here and looked up at run time, and contexts without them keep generating
+// on the CPU.
+//------------------------------------------------------------------------------
+
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_MAX_SHADER_STORAGE_BLOCK_SIZE
+#define GL_MAX_SHADER_STORAGE_BLOCK_SIZE 0x90DE
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_PIXEL_BUFFER_BARRIER_BIT
+#define GL_PIXEL_BUFFER_BARRIER_BIT 0x00000080
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+
+namespace GLCompute {
+
+	// Checks the current context for GL 4.3 or ARB_compute_shader plus
+	// ARB_shader_storage_buffer_object and loads glDispatchCompute and
+	// glMemoryBarrier. Call once the context is current.
+	bool load();
+
+	// Result of the last load()
+	bool available();
+
+	// glDispatchCompute(x, y, z)
+	void dispatch(GLuint x, GLuint y, GLuint z);
+
+	// glMemoryBarrier(barriers)
+	void memoryBarrier(GLbitfield barriers);
+
+	// Largest shader storage block in bytes, 0 without compute
+	GLint64 maxStorageBlockSize();
+}
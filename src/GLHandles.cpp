@@ -180,3 +180,92 @@ TextureHandle::operator GLuint() const {
 GLuint TextureHandle::value() const {
 	return textureID;
 }
+
+
+//------------------------------------------------------------------------------
+
+QueryHandle::QueryHandle()
+	: queryID(0) // Due to OpenGL syntax, we can't initial directly here, like we want.
+{
+	glGenQueries(1, &queryID);
+}
+
+
+QueryHandle::QueryHandle(QueryHandle&& other) noexcept
+	: queryID(std::move(other.queryID))
+{
+	other.queryID = 0;
+}
+
+QueryHandle& QueryHandle::operator=(QueryHandle&& other) noexcept {
+	std::swap(queryID, other.queryID);
+	return *this;
+}
+
+
+QueryHandle::~QueryHandle() {
+	glDeleteQueries(1, &queryID);
+}
+
+
+QueryHandle::operator GLuint() const {
+	return queryID;
+}
+
+
+GLuint QueryHandle::value() const {
+	return queryID;
+}
+
+//------------------------------------------------------------------------------
+
+SyncHandle::SyncHandle()
+	: sync(nullptr)
+{}
+
+
+SyncHandle::SyncHandle(SyncHandle&& other) noexcept
+	: sync(std::move(other.sync))
+{
+	other.sync = nullptr;
+}
+
+SyncHandle& SyncHandle::operator=(SyncHandle&& other) noexcept {
+	std::swap(sync, other.sync);
+	return *this;
+}
+
+
+SyncHandle::~SyncHandle() {
+	if (sync) {
+		glDeleteSync(sync);
+	}
+}
+
+
+void SyncHandle::place() {
+	if (sync) {
+		glDeleteSync(sync);
+	}
+	sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+
+bool SyncHandle::wait(GLuint64 timeout) {
+	if (!sync) {
+		return true;
+	}
+
+	GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+		glDeleteSync(sync);
+		sync = nullptr;
+		return true;
+	}
+	return false;
+}
+
+
+SyncHandle::operator GLsync() const {
+	return sync;
+}
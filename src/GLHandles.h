@@ -184,3 +184,64 @@ private:
 	GLuint textureID;
 
 };
+
+// An RAII class for managing a query object GLuint for OpenGL.
+class QueryHandle {
+
+public:
+	QueryHandle();
+
+	// Disallow copying
+	QueryHandle(const QueryHandle&) = delete;
+	QueryHandle operator=(const QueryHandle&) = delete;
+
+	// Allow moving
+	QueryHandle(QueryHandle&& other) noexcept;
+	QueryHandle& operator=(QueryHandle&& other) noexcept;
+
+	// Clean up after ourselves.
+	~QueryHandle();
+
+	// Allow casting from this type into a GLuint
+	// This allows usage in situations where a function expects a GLuint
+	operator GLuint() const;
+	GLuint value() const;
+
+private:
+	GLuint queryID;
+
+};
+
+// An RAII class for managing a GLsync fence for OpenGL.
+//
+// Unlike the other handles it starts out empty, place() puts a fence into the
+// command stream (replacing the previous one) and wait() blocks until the GPU
+// has passed it.
+class SyncHandle {
+
+public:
+	SyncHandle();
+
+	// Disallow copying
+	SyncHandle(const SyncHandle&) = delete;
+	SyncHandle operator=(const SyncHandle&) = delete;
+
+	// Allow moving
+	SyncHandle(SyncHandle&& other) noexcept;
+	SyncHandle& operator=(SyncHandle&& other) noexcept;
+
+	// Clean up after ourselves.
+	~SyncHandle();
+
+	void place();
+
+	// True once the GPU passed the fence, or when there is none. Gives up
+	// and returns false after timeout nanoseconds.
+	bool wait(GLuint64 timeout);
+
+	operator GLsync() const;
+
+private:
+	GLsync sync;
+
+};
@@ -0,0 +1,51 @@
+#include "GLTessellation.h"
+#include "Log.h"
+
+
+namespace {
+	typedef void (*PatchParameteriProc)(GLenum pname, GLint value);
+
+	PatchParameteriProc patchParameteri = nullptr;
+	GLint maxTessLevel = 0;
+}
+
+
+bool GLTessellation::load() {
+	patchParameteri = nullptr;
+	maxTessLevel = 0;
+
+	// The terrain tessellation shaders are #version 400, a 3.3 context
+	// with GL_ARB_tessellation_shader can't compile them
+	GLint major = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	if (major < 4) {
+		Log::info("TESSELLATION not supported by this context, using the vertex shader paths");
+		return false;
+	}
+
+	patchParameteri = (PatchParameteriProc)glfwGetProcAddress("glPatchParameteri");
+	if (patchParameteri == nullptr) {
+		Log::warn("TESSELLATION glPatchParameteri missing, using the vertex shader paths");
+		return false;
+	}
+	glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &maxTessLevel);
+	Log::info("TESSELLATION available, max level {}", maxTessLevel);
+	return true;
+}
+
+
+bool GLTessellation::available() {
+	return patchParameteri != nullptr;
+}
+
+
+void GLTessellation::setPatchVertices(GLint count) {
+	if (patchParameteri != nullptr) {
+		patchParameteri(GL_PATCH_VERTICES, count);
+	}
+}
+
+
+GLint GLTessellation::maxLevel() {
+	return maxTessLevel < 64 ? 64 : maxTessLevel;
+}
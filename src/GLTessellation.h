@@ -0,0 +1,44 @@
+#pragma once
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+//------------------------------------------------------------------------------
+// Tessellation shaders are core in OpenGL 4.0, the GL loader is generated for
+// the 3.3 core profile. The few enums and the one entry point the terrain
+// tessellation path needs are declared here and looked up at run time, so
+// the same build runs on 3.3 contexts and just goes without.
+//------------------------------------------------------------------------------
+
+#ifndef GL_PATCHES
+#define GL_PATCHES 0x000E
+#endif
+#ifndef GL_PATCH_VERTICES
+#define GL_PATCH_VERTICES 0x8E72
+#endif
+#ifndef GL_TESS_EVALUATION_SHADER
+#define GL_TESS_EVALUATION_SHADER 0x8E87
+#endif
+#ifndef GL_TESS_CONTROL_SHADER
+#define GL_TESS_CONTROL_SHADER 0x8E88
+#endif
+#ifndef GL_MAX_TESS_GEN_LEVEL
+#define GL_MAX_TESS_GEN_LEVEL 0x8E7E
+#endif
+
+
+namespace GLTessellation {
+
+	// Checks the current context for GL 4.0 and loads glPatchParameteri.
+	// Call once the context is current.
+	bool load();
+
+	// Result of the last load()
+	bool available();
+
+	// glPatchParameteri(GL_PATCH_VERTICES, count)
+	void setPatchVertices(GLint count);
+
+	// Highest tessellation level the context supports, at least 64
+	GLint maxLevel();
+}
@@ -1,5 +1,8 @@
 #include "Geometry.h"
 
+#include "DrawStats.h"
+
+#include <cstddef>
 #include <utility>
 
 
@@ -8,6 +11,12 @@ GPU_Geometry::GPU_Geometry()
 	, vertBuffer(0, 3, GL_FLOAT)
 	, normalsBuffer(1, 3, GL_FLOAT)
 	, texCoordBuffer(2, 2, GL_FLOAT)
+	, indexBuffer()
+	, packedBuffer()
+	, floatLocations{ 0, 1, 2 }
+	, packedLocations{ -1, -1 }
+	, indexCount(0)
+	, indexType(GL_UNSIGNED_INT)
 {}
 
 
@@ -24,9 +33,98 @@ void GPU_Geometry::setTexCoords(const std::vector<glm::vec2>& texCoords) {
 	texCoordBuffer.uploadData(sizeof(glm::vec2) * texCoords.size(), texCoords.data(), GL_STATIC_DRAW);
 }
 
+void GPU_Geometry::setPackedVerts(const std::vector<PackedTerrainVertex>& verts) {
+	packedBuffer.uploadData(sizeof(PackedTerrainVertex) * verts.size(), verts.data(), GL_STATIC_DRAW);
+}
+
+glm::vec3* GPU_Geometry::mapVerts(size_t count) {
+	return (glm::vec3*)vertBuffer.mapForWrite(sizeof(glm::vec3) * count, GL_STATIC_DRAW);
+}
+
+glm::vec3* GPU_Geometry::mapNormals(size_t count) {
+	return (glm::vec3*)normalsBuffer.mapForWrite(sizeof(glm::vec3) * count, GL_STATIC_DRAW);
+}
+
+PackedTerrainVertex* GPU_Geometry::mapPackedVerts(size_t count) {
+	return (PackedTerrainVertex*)packedBuffer.mapForWrite(sizeof(PackedTerrainVertex) * count, GL_STATIC_DRAW);
+}
+
+bool GPU_Geometry::unmapVertices() {
+	// Every buffer has to be unmapped, even after one failed
+	bool verts = vertBuffer.unmap();
+	bool normals = normalsBuffer.unmap();
+	bool packed = packedBuffer.unmap();
+	return verts && normals && packed;
+}
+
+void GPU_Geometry::bindVertexStorage(size_t count, GLuint vertBinding, GLuint normalBinding) {
+	vertBuffer.bindStorage(vertBinding, sizeof(glm::vec3) * count, GL_STATIC_DRAW);
+	normalsBuffer.bindStorage(normalBinding, sizeof(glm::vec3) * count, GL_STATIC_DRAW);
+}
+
+void GPU_Geometry::setIndices(const std::vector<unsigned int>& indices, size_t vertexCount) {
+	// The element buffer binding lives in the VAO
+	vao.bind();
+
+	if (vertexCount <= 65536) {
+		std::vector<GLushort> shortIndices(indices.begin(), indices.end());
+		indexBuffer.uploadData(sizeof(GLushort) * shortIndices.size(), shortIndices.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_SHORT;
+	}
+	else {
+		indexBuffer.uploadData(sizeof(GLuint) * indices.size(), indices.data(), GL_STATIC_DRAW);
+		indexType = GL_UNSIGNED_INT;
+	}
+	indexCount = (GLsizei)indices.size();
+}
+
+size_t GPU_Geometry::bytes() const {
+	return (size_t)(vertBuffer.getCapacity() + normalsBuffer.getCapacity() + texCoordBuffer.getCapacity()
+		+ packedBuffer.getCapacity() + indexBuffer.getCapacity());
+}
+
+void GPU_Geometry::drawElements(GLenum mode) {
+	vao.bind();
+	glDrawElements(mode, indexCount, indexType, nullptr);
+	DrawStats::count(mode, indexCount);
+}
+
+void GPU_Geometry::drawElements(GLenum mode, GLsizei first, GLsizei count) {
+	vao.bind();
+	size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+	glDrawElements(mode, count, indexType, (void*)(first * indexSize));
+	DrawStats::count(mode, count);
+}
+
+void GPU_Geometry::drawElements(GLenum mode, const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) {
+	vao.bind();
+	size_t indexSize = (indexType == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+	rangeOffsets.resize(firsts.size());
+	for (size_t i = 0; i < firsts.size(); i++) {
+		rangeOffsets[i] = (const void*)(firsts[i] * indexSize);
+	}
+	glMultiDrawElements(mode, counts.data(), indexType, rangeOffsets.data(), (GLsizei)counts.size());
+	DrawStats::countMulti(mode, counts.data(), counts.size());
+}
+
+void GPU_Geometry::drawArrays(GLenum mode, const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) {
+	vao.bind();
+	glMultiDrawArrays(mode, firsts.data(), counts.data(), (GLsizei)counts.size());
+	DrawStats::countMulti(mode, counts.data(), counts.size());
+}
+
 void GPU_Geometry::setup(int vertLocation, int normalLocation, int texCoordLocation) {
 	vao.bind();
 
+	// Switching back from the packed layout
+	for (int location : packedLocations) {
+		if (location >= 0) glDisableVertexAttribArray(location);
+	}
+	packedLocations[0] = packedLocations[1] = -1;
+	floatLocations[0] = vertLocation;
+	floatLocations[1] = normalLocation;
+	floatLocations[2] = texCoordLocation;
+
 	// Enable vertex attribute pointers
 	glEnableVertexAttribArray(vertLocation);
 	glEnableVertexAttribArray(normalLocation);
@@ -44,3 +142,39 @@ void GPU_Geometry::setup(int vertLocation, int normalLocation, int texCoordLocat
 	texCoordBuffer.bind();
 	glVertexAttribPointer(texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 }
+
+void GPU_Geometry::setupPacked(int heightLocation, int normalLocation) {
+	vao.bind();
+
+	// The float streams hold stale data in this mode
+	for (int location : floatLocations) {
+		if (location >= 0) glDisableVertexAttribArray(location);
+	}
+	floatLocations[0] = floatLocations[1] = floatLocations[2] = -1;
+	packedLocations[0] = heightLocation;
+	packedLocations[1] = normalLocation;
+
+	glEnableVertexAttribArray(heightLocation);
+	glEnableVertexAttribArray(normalLocation);
+
+	// Normalized integers, so the shader sees height in [0, 1] and the
+	// octahedral normal in [-1, 1]
+	packedBuffer.bind();
+	glVertexAttribPointer(heightLocation, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedTerrainVertex),
+		(void*)offsetof(PackedTerrainVertex, height));
+	glVertexAttribPointer(normalLocation, 2, GL_SHORT, GL_TRUE, sizeof(PackedTerrainVertex),
+		(void*)offsetof(PackedTerrainVertex, normal));
+}
+
+void GPU_Geometry::setupAttributeless() {
+	vao.bind();
+
+	for (int location : floatLocations) {
+		if (location >= 0) glDisableVertexAttribArray(location);
+	}
+	for (int location : packedLocations) {
+		if (location >= 0) glDisableVertexAttribArray(location);
+	}
+	floatLocations[0] = floatLocations[1] = floatLocations[2] = -1;
+	packedLocations[0] = packedLocations[1] = -1;
+}
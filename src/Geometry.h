@@ -6,8 +6,10 @@
 // similar classes with the needed functionality
 //------------------------------------------------------------------------------
 
+#include "IndexBuffer.h"
 #include "VertexArray.h"
 #include "VertexBuffer.h"
+#include "Vertex.h"
 
 //#include <GL/glew.h>
 #include <glad/glad.h>
@@ -22,10 +24,18 @@ struct CPU_Geometry {
 	std::vector<glm::vec3> verts;
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec2> texCoords;
+	std::vector<unsigned int> indices;
+
+	// Memory held by the vectors
+	size_t bytes() const {
+		return verts.capacity() * sizeof(glm::vec3) + normals.capacity() * sizeof(glm::vec3)
+			+ texCoords.capacity() * sizeof(glm::vec2) + indices.capacity() * sizeof(unsigned int);
+	}
 };
 
 
-// VAO and two VBOs for storing vertices and texture coordinates, respectively
+// VAO and VBOs for storing vertices, normals and texture coordinates, plus an
+// optional element buffer for indexed drawing
 class GPU_Geometry {
 
 public:
@@ -39,6 +49,45 @@ public:
 	void setTexCoords(const std::vector<glm::vec2>& texCoords);
 	void setup(int vertLocation, int normalLocation, int texCoordLocation);
 
+	// Interleaved PackedTerrainVertex stream. setupPacked() switches the VAO
+	// from the float streams to it, setup() switches back.
+	void setPackedVerts(const std::vector<PackedTerrainVertex>& verts);
+	void setupPacked(int heightLocation, int normalLocation);
+	// No vertex attributes at all, the shader works from gl_VertexID
+	void setupAttributeless();
+
+	// Map the streams for count vertices so they can be filled in place
+	// instead of going through setVerts/setNormals/setPackedVerts. See
+	// VertexBuffer::mapForWrite. unmapVertices() has to run on the GL thread
+	// before the next draw.
+	glm::vec3* mapVerts(size_t count);
+	glm::vec3* mapNormals(size_t count);
+	PackedTerrainVertex* mapPackedVerts(size_t count);
+	// Unmaps whatever is mapped, false when contents got lost
+	bool unmapVertices();
+	// Sizes the float position and normal streams for count vertices and
+	// binds them as shader storage, for a compute shader to write the
+	// vertices instead. See VertexBuffer::bindStorage.
+	void bindVertexStorage(size_t count, GLuint vertBinding, GLuint normalBinding);
+
+	// Uploads the index buffer. Stored as 16-bit indices when every vertex
+	// fits (vertexCount <= 65536), as 32-bit otherwise.
+	void setIndices(const std::vector<unsigned int>& indices, size_t vertexCount);
+
+	// Draws the uploaded indices with glDrawElements
+	void drawElements(GLenum mode);
+	// Draws count indices starting at index first
+	void drawElements(GLenum mode, GLsizei first, GLsizei count);
+	// Several index ranges in one glMultiDrawElements call
+	void drawElements(GLenum mode, const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts);
+	// Several vertex ranges in one glMultiDrawArrays call, no indices
+	void drawArrays(GLenum mode, const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts);
+
+	GLsizei getIndexCount() const { return indexCount; }
+	GLenum getIndexType() const { return indexType; }
+	// GPU memory allocated for the streams and indices
+	size_t bytes() const;
+
 	//get the VAO
 	VertexArray& getVAO() { return vao; }
 
@@ -50,4 +99,16 @@ private:
 	VertexBuffer vertBuffer;
 	VertexBuffer normalsBuffer;
 	VertexBuffer texCoordBuffer;
+	IndexBuffer indexBuffer;
+	VertexBuffer packedBuffer;
+
+	// Attribute locations enabled by setup() / setupPacked()
+	int floatLocations[3];
+	int packedLocations[2];
+
+	GLsizei indexCount;
+	GLenum indexType;
+
+	// Byte offsets of the last multi-draw, kept to save the allocation
+	std::vector<const void*> rangeOffsets;
 };
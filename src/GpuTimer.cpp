@@ -0,0 +1,97 @@
+#include "GpuTimer.h"
+
+#include <algorithm>
+
+
+GpuTimer::GpuTimer()
+	: frame(0)
+	, active(-1)
+{}
+
+
+void GpuTimer::begin(const std::string& name) {
+	if (active >= 0) {
+		return;
+	}
+
+	size_t index = 0;
+	while (index < passes.size() && passes[index].name != name) {
+		index++;
+	}
+	if (index == passes.size()) {
+		passes.emplace_back();
+		passes.back().name = name;
+	}
+
+	// The query this frame reuses must be read first, without waiting
+	Pass& pass = passes[index];
+	int slot = frame % Latency;
+	if (pass.issued[slot] && !collect(pass, slot)) {
+		return;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+	active = (int)index;
+}
+
+
+void GpuTimer::end() {
+	if (active < 0) {
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	passes[active].issued[frame % Latency] = true;
+	active = -1;
+}
+
+
+void GpuTimer::endFrame() {
+	end();
+
+	// Oldest first, so the newest result that arrived is the one kept
+	for (Pass& pass : passes) {
+		for (int i = 1; i <= Latency; i++) {
+			int slot = (frame + i) % Latency;
+			if (pass.issued[slot]) {
+				collect(pass, slot);
+			}
+		}
+	}
+	frame++;
+}
+
+
+bool GpuTimer::collect(Pass& pass, int slot) {
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &nanoseconds);
+	pass.milliseconds = (float)((double)nanoseconds / 1e6);
+	pass.issued[slot] = false;
+	return true;
+}
+
+
+std::vector<GpuTimer::Result> GpuTimer::results() const {
+	std::vector<Result> out;
+	out.reserve(passes.size());
+	for (const Pass& pass : passes) {
+		out.push_back({ pass.name, pass.milliseconds });
+	}
+	return out;
+}
+
+
+float GpuTimer::totalMilliseconds() const {
+	float total = -1.0f;
+	for (const Pass& pass : passes) {
+		if (pass.milliseconds >= 0.0f) {
+			total = std::max(total, 0.0f) + pass.milliseconds;
+		}
+	}
+	return total;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// GPU time of render passes from GL_TIME_ELAPSED queries.
+//
+// Every pass has a ring of Latency queries, one per frame. Results are read
+// once the GPU made them available, a few frames after the pass ran, so the
+// render thread never waits for them. A pass whose query from Latency frames
+// ago is still outstanding isn't timed that frame.
+//------------------------------------------------------------------------------
+
+#include "GLHandles.h"
+
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+
+class GpuTimer {
+
+public:
+	// Frames the query ring of a pass covers
+	static constexpr int Latency = 4;
+
+	struct Result {
+		std::string pass;
+		float milliseconds;   // < 0 until the first result arrived
+	};
+
+	GpuTimer();
+
+	// Times the GL commands until end() as pass, once per frame. Passes
+	// can't nest, GL runs one time elapsed query at a time.
+	void begin(const std::string& pass);
+	void end();
+
+	// Once per frame after the last pass. Reads the results that arrived
+	// and moves on to the next queries.
+	void endFrame();
+
+	// Newest result of every pass, in the order they were first timed
+	std::vector<Result> results() const;
+	// Sum of the newest results, < 0 until one arrived
+	float totalMilliseconds() const;
+
+private:
+	struct Pass {
+		std::string name;
+		std::array<QueryHandle, Latency> queries;
+		std::array<bool, Latency> issued{};
+		float milliseconds = -1.0f;
+	};
+
+	std::vector<Pass> passes;
+	unsigned frame;
+	int active;      // pass between begin() and end(), -1 for none
+
+	// Takes the result of the query in slot when it is there, false when
+	// the GPU isn't done with it yet
+	bool collect(Pass& pass, int slot);
+};
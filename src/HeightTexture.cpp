@@ -0,0 +1,36 @@
+#include "HeightTexture.h"
+#include "Profiler.h"
+
+
+HeightTexture::HeightTexture()
+	: textureID()
+	, size(0)
+{}
+
+
+void HeightTexture::upload(int newSize, const float* heights) {
+	PROFILE_ZONE("height texture upload");
+	PROFILE_COUNT("bytes uploaded", (size_t)newSize * newSize * sizeof(float));
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (newSize != size) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, newSize, newSize, 0, GL_RED, GL_FLOAT, heights);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		size = newSize;
+	}
+	else {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RED, GL_FLOAT, heights);
+	}
+}
+
+
+void HeightTexture::bind(GLuint unit) {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glActiveTexture(GL_TEXTURE0);
+}
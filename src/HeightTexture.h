@@ -0,0 +1,34 @@
+#pragma once
+
+#include "GLHandles.h"
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+
+
+// Single channel float texture holding a square heightfield, one texel per
+// grid vertex. Filtered linearly for the morphing CDLOD patches, texelFetch
+// reads of whole vertices are unaffected by that.
+class HeightTexture {
+public:
+	HeightTexture();
+
+	// Rule of zero, the TextureHandle does the RAII for us
+
+	// Uploads size x size heights, row by row. Reallocates the texture when
+	// the size changes, otherwise only replaces its contents.
+	void upload(int size, const float* heights);
+
+	// Binds to texture unit 'unit' and leaves unit 0 active
+	void bind(GLuint unit);
+
+	int getSize() const { return size; }
+	// GPU memory of the texture, one float per texel
+	size_t bytes() const { return (size_t)size * size * sizeof(float); }
+
+private:
+	TextureHandle textureID;
+	int size;
+};
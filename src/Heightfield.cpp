@@ -0,0 +1,271 @@
+#include "Heightfield.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+HeightfieldSampler::HeightfieldSampler(const config& cfg)
+	: noise(cfg.seed)
+	, params(cfg)
+	, kernel(selectRidgedKernel<float>(params.octaves))
+	, simd(cfg.simd != 0)
+	, width(cfg.width)
+	, height(cfg.height)
+	, subdivisions(cfg.subdivisions)
+{}
+
+
+void HeightfieldSampler::sampleRow(int row, int colBegin, int colEnd, float* out) const {
+	float xs[ChunkSize];
+	float ys[ChunkSize];
+
+	for (int begin = colBegin; begin < colEnd; begin += ChunkSize) {
+		int count = std::min(ChunkSize, colEnd - begin);
+		rowCoords(row, begin, count, xs, ys);
+
+		float* heights = out + (begin - colBegin);
+		ridged(xs, ys, heights, count);
+		finish(xs, ys, heights, count);
+	}
+}
+
+
+void HeightfieldSampler::sampleRowGradient(int row, int colBegin, int colEnd, float* out, float* slopeX, float* slopeZ) const {
+	float xs[ChunkSize];
+	float ys[ChunkSize];
+	float dxs[ChunkSize];
+	float dys[ChunkSize];
+
+	for (int begin = colBegin; begin < colEnd; begin += ChunkSize) {
+		int count = std::min(ChunkSize, colEnd - begin);
+		rowCoords(row, begin, count, xs, ys);
+
+		float* heights = out + (begin - colBegin);
+		ridgedMFGradient(noise, params, xs, ys, heights, dxs, dys, count);
+
+		for (int k = 0; k < count; k++) {
+			// Same falloff as finish(), differentiated where it isn't flat
+			float dx = std::fabs(xs[k] - 0.5f);
+			float dy = std::fabs(ys[k] - 0.5f);
+			float distance = std::sqrt(dx * dx + dy * dy);
+			float falloff = std::min(1.0f - (distance / 0.5f), 1.0f);
+			float falloffDx = 0.0f;
+			float falloffDy = 0.0f;
+			if (falloff < 0.0f) {
+				falloff = 0.0f;
+			}
+			else if (distance > 0.0f) {
+				falloffDx = -2.0f * (xs[k] - 0.5f) / distance;
+				falloffDy = -2.0f * (ys[k] - 0.5f) / distance;
+			}
+
+			float ridged = heights[k];
+			float finalHeight = ridged * falloff * HeightScale;
+			float sign = (finalHeight < 0) ? -1.0f : 1.0f;
+			heights[k] = (finalHeight < 0) ? -finalHeight : finalHeight;
+
+			float heightDx = sign * HeightScale * (dxs[k] * falloff + ridged * falloffDx);
+			float heightDy = sign * HeightScale * (dys[k] * falloff + ridged * falloffDy);
+
+			// Noise x grows with world x, noise y shrinks as world z grows
+			slopeX[begin - colBegin + k] = heightDx / (float)width;
+			slopeZ[begin - colBegin + k] = -heightDy / (float)height;
+		}
+	}
+}
+
+
+void HeightfieldSampler::sampleTileRow(int tileX, int tileZ, int cells, int row, float* out) const {
+	float xs[ChunkSize];
+	float ys[ChunkSize];
+
+	// Samples past the edge are taken in the neighbouring tile's own
+	// coordinates, so they come out the same as there
+	auto wrap = [cells](int& tile, int& index) {
+		if (index < 0) {
+			tile--;
+			index += cells;
+		}
+		else if (index > cells) {
+			tile++;
+			index -= cells;
+		}
+	};
+
+	// Noise space in tile units, y shrinking as world z grows like in
+	// rowCoords(). Whole numbers at every tile edge.
+	int z = tileZ;
+	wrap(z, row);
+	float y = (float)(1 - z) - row / (float)cells;
+
+	int samples = cells + 3;
+	for (int begin = 0; begin < samples; begin += ChunkSize) {
+		int count = std::min(ChunkSize, samples - begin);
+		for (int k = 0; k < count; k++) {
+			int x = tileX;
+			int col = begin + k - 1;
+			wrap(x, col);
+			xs[k] = (float)x + col / (float)cells;
+			ys[k] = y;
+		}
+
+		float* heights = out + begin;
+		ridged(xs, ys, heights, count);
+		for (int k = 0; k < count; k++) {
+			float finalHeight = heights[k] * HeightScale;
+			heights[k] = (finalHeight < 0) ? -finalHeight : finalHeight;
+		}
+	}
+}
+
+
+void HeightfieldSampler::noiseRow(int octave, int row, int colBegin, int colEnd, float* out) const {
+	float xs[ChunkSize];
+	float ys[ChunkSize];
+	float freq = params.frequency[octave];
+
+	for (int begin = colBegin; begin < colEnd; begin += ChunkSize) {
+		int count = std::min(ChunkSize, colEnd - begin);
+		rowCoords(row, begin, count, xs, ys);
+
+		for (int k = 0; k < count; k++) {
+			xs[k] *= freq;
+			ys[k] *= freq;
+		}
+
+		// The same noise calls ridged() makes on either path
+		float* h = out + (begin - colBegin);
+		if (simd) {
+			noise.noise2D(xs, ys, h, count);
+		}
+		else {
+			for (int k = 0; k < count; k++) {
+				h[k] = (float)noise.noise2D(xs[k], ys[k]);
+			}
+		}
+	}
+}
+
+
+void HeightfieldSampler::combineRow(const float* const* layers, int row, int colBegin, int colEnd, float* out) const {
+	float xs[ChunkSize];
+	float ys[ChunkSize];
+	float prev[ChunkSize];
+	const float offset = params.offset;
+
+	for (int begin = colBegin; begin < colEnd; begin += ChunkSize) {
+		int count = std::min(ChunkSize, colEnd - begin);
+		float* sum = out + (begin - colBegin);
+
+		for (int k = 0; k < count; k++) {
+			sum[k] = 0.0f;
+			prev[k] = 1.0f;
+		}
+
+		// Branch free ridge() so the compiler can vectorize the octave loop,
+		// both sides are evaluated and the same one is picked
+		for (int i = 0; i < params.octaves; i++) {
+			const float* h = layers[i] + (begin - colBegin);
+			float amp = params.amplitude[i];
+
+			for (int k = 0; k < count; k++) {
+				float r = offset - std::fabs(h[k]);
+				float term = 2.0f * r - 2.0f;
+				float low = 4.0f * r * r * r;
+				float high = (r - 1.0f) * term * term + 1.0f;
+				float v = (r < 0.5f) ? low : high;
+
+				sum[k] += v * amp * prev[k];
+				prev[k] = v;
+			}
+		}
+
+		rowCoords(row, begin, count, xs, ys);
+		finish(xs, ys, sum, count);
+	}
+}
+
+
+void HeightfieldSampler::sample(const float* xs, const float* ys, float* out, int n) const {
+	ridged(xs, ys, out, n);
+	finish(xs, ys, out, n);
+}
+
+
+float HeightfieldSampler::sample(float x, float y) const {
+	float h;
+	sample(&x, &y, &h, 1);
+	return h;
+}
+
+
+void HeightfieldSampler::ridged(const float* xs, const float* ys, float* out, int n) const {
+	if (!simd) {
+		// Scalar double precision noise through the unrolled kernels
+		kernel(noise, params, xs, ys, out, n);
+		return;
+	}
+
+	// Octave by octave over a chunk, so every octave is one batched noise call
+	float fx[ChunkSize];
+	float fy[ChunkSize];
+	float h[ChunkSize];
+	float prev[ChunkSize];
+
+	for (int begin = 0; begin < n; begin += ChunkSize) {
+		int count = std::min(ChunkSize, n - begin);
+		float* sum = out + begin;
+
+		for (int k = 0; k < count; k++) {
+			sum[k] = 0.0f;
+			prev[k] = 1.0f;
+		}
+
+		for (int i = 0; i < params.octaves; i++) {
+			float freq = params.frequency[i];
+			float amp = params.amplitude[i];
+
+			for (int k = 0; k < count; k++) {
+				fx[k] = xs[begin + k] * freq;
+				fy[k] = ys[begin + k] * freq;
+			}
+
+			noise.noise2D(fx, fy, h, count);
+
+			for (int k = 0; k < count; k++) {
+				float v = ridge(h[k], params.offset);
+				sum[k] += v * amp * prev[k];
+				prev[k] = v;
+			}
+		}
+	}
+}
+
+
+void HeightfieldSampler::rowCoords(int row, int colBegin, int count, float* xs, float* ys) const {
+	float posZ = gridZ(row);
+	float y = (-(posZ)+(height / 2.0f)) / (float)height;
+
+	for (int k = 0; k < count; k++) {
+		float posX = gridX(colBegin + k);
+		xs[k] = (posX + (width / 2.0f)) / (float)width;
+		ys[k] = y;
+	}
+}
+
+
+void HeightfieldSampler::finish(const float* xs, const float* ys, float* heights, int n) const {
+	for (int k = 0; k < n; k++) {
+		// Radial falloff to zero at the edge of the inscribed circle
+		float dx = std::fabs(xs[k] - 0.5f);
+		float dy = std::fabs(ys[k] - 0.5f);
+		float distance = std::sqrt(dx * dx + dy * dy);
+		float falloff = std::min(1.0f - (distance / 0.5f), 1.0f);
+		if (falloff < 0.0f) {
+			falloff = 0.0f;
+		}
+
+		float finalHeight = heights[k] * falloff * HeightScale;
+		heights[k] = (finalHeight < 0) ? -finalHeight : finalHeight;
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Height evaluation for the terrain grid.
+//
+// HeightfieldSampler is the one entry point for turning a config into terrain
+// heights: ridged multifractal noise, the radial falloff towards the edges and
+// the final height scale. It is built once per regen, is safe to share between
+// threads and evaluates whole row spans without allocating.
+//------------------------------------------------------------------------------
+
+#include "config.h"
+#include "RidgedMF.h"
+#include "SimplexNoise.h"
+
+
+class HeightfieldSampler {
+
+public:
+	explicit HeightfieldSampler(const config& cfg);
+
+	// Vertices per side of the (subdivisions+1) x (subdivisions+1) grid
+	int resolution() const { return subdivisions + 1; }
+
+	// World space x of a grid column and z of a grid row
+	float gridX(int col) const { return col * (width / (float)subdivisions) - (width / 2.0f); }
+	float gridZ(int row) const { return row * (height / (float)subdivisions) - (height / 2.0f); }
+
+	// Final heights of columns [colBegin, colEnd) of a grid row
+	void sampleRow(int row, int colBegin, int colEnd, float* out) const;
+
+	// Final heights at n arbitrary points given in the [0, 1] terrain
+	// coordinates the noise is evaluated in
+	void sample(const float* xs, const float* ys, float* out, int n) const;
+	float sample(float x, float y) const;
+
+	// Raw ridged multifractal, before falloff and scaling
+	void ridged(const float* xs, const float* ys, float* out, int n) const;
+
+	// Raw simplex noise of one octave along a grid row, before the ridge
+	// function. Only depends on seed, frequency, lacunarity, simd and the
+	// grid, so it can be cached across gain and ridgeOffset edits.
+	void noiseRow(int octave, int row, int colBegin, int colEnd, float* out) const;
+
+	// Same result as sampleRow() from precomputed noiseRow() spans, one per
+	// octave. layers[i] points at the span of octave i.
+	void combineRow(const float* const* layers, int row, int colBegin, int colEnd, float* out) const;
+
+	// sampleRow() plus the world space gradient of the final heights,
+	// slopeX = dh/dx and slopeZ = dh/dz, from analytic noise derivatives.
+	// Heights match sampleRow() with simd off.
+	void sampleRowGradient(int row, int colBegin, int colEnd, float* out, float* slopeX, float* slopeZ) const;
+
+	// Heights of a row of world tile (tileX, tileZ) split into cells x cells
+	// quads. Tile (0, 0) covers the same noise as the single mountain but
+	// without the falloff, and tile edges land on the exact same noise
+	// coordinates, so neighbouring tiles share their border vertices bit for
+	// bit. Rows and columns go from -1 to cells + 1, cells + 3 values: the
+	// extra ones are the neighbouring tiles' first samples past the edge, for
+	// border normals that match on both sides.
+	void sampleTileRow(int tileX, int tileZ, int cells, int row, float* out) const;
+
+	int octaves() const { return params.octaves; }
+
+	static constexpr float HeightScale = 15.0f;
+
+private:
+	// Samples are processed in chunks of this size with scratch on the stack
+	static constexpr int ChunkSize = 256;
+
+	SimplexNoise noise;
+	RidgedParams<float> params;
+	RidgedKernel<float> kernel;
+	bool simd;
+
+	int width;
+	int height;
+	int subdivisions;
+
+	// Noise space coordinates of a grid row span
+	void rowCoords(int row, int colBegin, int count, float* xs, float* ys) const;
+	void finish(const float* xs, const float* ys, float* heights, int n) const;
+};
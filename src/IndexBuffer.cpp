@@ -0,0 +1,14 @@
+#include "IndexBuffer.h"
+
+
+IndexBuffer::IndexBuffer()
+	: bufferID{}
+	, capacity(0)
+{}
+
+
+void IndexBuffer::uploadData(GLsizeiptr size, const void* data, GLenum usage) {
+	bind();
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, usage);
+	capacity = size;
+}
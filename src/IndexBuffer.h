@@ -0,0 +1,30 @@
+#pragma once
+
+#include "GLHandles.h"
+
+//#include <GL/glew.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+
+// Element array buffer holding the indices of an indexed mesh.
+//
+// The GL_ELEMENT_ARRAY_BUFFER binding is part of the vertex array state,
+// so the owning VAO has to be bound before bind() or uploadData().
+class IndexBuffer {
+
+public:
+	IndexBuffer();
+
+	// Same rule of zero as VertexBuffer, the handle does the RAII for us
+
+	// Public interface
+	void bind() const { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferID); }
+	void uploadData(GLsizeiptr size, const void* data, GLenum usage);
+	// Bytes allocated by the last upload
+	GLsizeiptr getCapacity() const { return capacity; }
+
+private:
+	VertexBufferHandle bufferID;
+	GLsizeiptr capacity;
+};
@@ -0,0 +1,119 @@
+#include "NoiseLayerCache.h"
+
+#include <algorithm>
+
+
+bool NoiseLayerCache::Key::operator==(const Key& other) const {
+	return seed == other.seed
+		&& frequency == other.frequency
+		&& lacunarity == other.lacunarity
+		&& simd == other.simd
+		&& width == other.width
+		&& height == other.height
+		&& subdivisions == other.subdivisions;
+}
+
+
+NoiseLayerCache::NoiseLayerCache()
+	: key()
+	, layers()
+	, budget(0)
+	, reused(0)
+	, computed(0)
+{}
+
+
+void NoiseLayerCache::setBudget(size_t bytes) {
+	budget = bytes;
+	if (budget == 0) {
+		clear();
+	}
+}
+
+
+bool NoiseLayerCache::heights(const HeightfieldSampler& sampler, const config& cfg, ThreadPool& pool, float* out,
+	const CancelToken& cancel) {
+	reused = 0;
+	computed = 0;
+
+	int gridSize = sampler.resolution();
+	int octaves = sampler.octaves();
+	size_t layerSize = (size_t)gridSize * gridSize;
+
+	// Layers of an earlier config would only hold on to memory now that
+	// this one is evaluated in full
+	if (octaves * layerSize * sizeof(float) > budget) {
+		clear();
+		return false;
+	}
+
+	Key current;
+	current.seed = cfg.seed;
+	current.frequency = cfg.frequency;
+	current.lacunarity = cfg.lacunarity;
+	current.simd = cfg.simd;
+	current.width = cfg.width;
+	current.height = cfg.height;
+	current.subdivisions = cfg.subdivisions;
+
+	if (!(current == key)) {
+		clear();
+		key = current;
+	}
+
+	// Layers for octaves that were dropped stay around for when they come
+	// back, as long as they fit
+	if (layers.size() * layerSize * sizeof(float) > budget) {
+		layers.resize(octaves);
+	}
+
+	reused = std::min(octaves, (int)layers.size());
+	for (int octave = (int)layers.size(); octave < octaves; octave++) {
+		layers.emplace_back(layerSize);
+		float* layer = layers.back().data();
+
+		pool.parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+			if (cancel.cancelled()) {
+				return;
+			}
+			for (int row = rowBegin; row < rowEnd; row++) {
+				sampler.noiseRow(octave, row, 0, gridSize, layer + (size_t)row * gridSize);
+			}
+		});
+
+		// A partly filled layer must not stay in the cache
+		if (cancel.cancelled()) {
+			layers.pop_back();
+			return false;
+		}
+		computed++;
+	}
+
+	pool.parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+		std::vector<const float*> rowLayers(octaves);
+		for (int row = rowBegin; row < rowEnd; row++) {
+			for (int i = 0; i < octaves; i++) {
+				rowLayers[i] = layers[i].data() + (size_t)row * gridSize;
+			}
+			sampler.combineRow(rowLayers.data(), row, 0, gridSize, out + (size_t)row * gridSize);
+		}
+	});
+
+	return true;
+}
+
+
+void NoiseLayerCache::clear() {
+	layers.clear();
+	layers.shrink_to_fit();
+	key = Key();
+}
+
+
+size_t NoiseLayerCache::bytes() const {
+	size_t total = 0;
+	for (const std::vector<float>& layer : layers) {
+		total += layer.size() * sizeof(float);
+	}
+	return total;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Per-octave raw noise layers of the terrain grid.
+//
+// The simplex samples behind every octave only depend on the seed, frequency,
+// lacunarity, the noise path and the grid. Edits to gain, ridgeOffset or the
+// octave count keep those layers valid, so the heights can be recombined from
+// memory instead of evaluating the noise again. Layers are kept while they fit
+// the byte budget, past it heights are evaluated in full.
+//------------------------------------------------------------------------------
+
+#include "CancelToken.h"
+#include "config.h"
+#include "Heightfield.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+#include <vector>
+
+
+class NoiseLayerCache {
+
+public:
+	NoiseLayerCache();
+
+	// 0 disables the cache and frees the layers
+	void setBudget(size_t bytes);
+	size_t getBudget() const { return budget; }
+
+	// Writes the (subdivisions+1)^2 grid heights for cfg into out, computing
+	// and caching the octave layers that are missing. Returns false when the
+	// layers would not fit the budget, which also drops the cached ones, or
+	// the build was cancelled.
+	bool heights(const HeightfieldSampler& sampler, const config& cfg, ThreadPool& pool, float* out,
+		const CancelToken& cancel = CancelToken());
+
+	void clear();
+
+	// Memory held by the cached layers
+	size_t bytes() const;
+
+	// Layers reused and computed by the last heights() call
+	int getReused() const { return reused; }
+	int getComputed() const { return computed; }
+
+private:
+	// Everything a raw noise layer depends on
+	struct Key {
+		int seed = 0;
+		float frequency = 0.0f;
+		float lacunarity = 0.0f;
+		int simd = 0;
+		int width = 0;
+		int height = 0;
+		int subdivisions = -1;
+
+		bool operator==(const Key& other) const;
+	};
+
+	Key key;
+	std::vector<std::vector<float>> layers; // layers[i] = octave i, row by row
+	size_t budget;
+	int reused;
+	int computed;
+};
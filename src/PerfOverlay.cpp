@@ -0,0 +1,142 @@
+#include "PerfOverlay.h"
+
+#include "DrawStats.h"
+#include "imgui/imgui.h"
+#include "imgui/imgui_impl_glfw.h"
+#include "imgui/imgui_impl_opengl3.h"
+
+#include <algorithm>
+#include <cstdio>
+
+
+namespace {
+	float megabytes(size_t bytes) {
+		return (float)bytes / (1024.0f * 1024.0f);
+	}
+
+	float milliseconds(double seconds) {
+		return (float)(seconds * 1000.0);
+	}
+}
+
+
+PerfOverlay::PerfOverlay()
+	: cpuHistory{}
+	, gpuHistory{}
+	, next(0)
+	, frames(0)
+	, gpuFrames(0)
+	, frameMilliseconds(0.0f)
+	, visible(false)
+{}
+
+
+void PerfOverlay::addFrame(float frameMs, float cpuMs, float gpuMs) {
+	// A frame without a GPU time drops out of the GPU history as it ages
+	if (frames == HistorySize && gpuHistory[next] >= 0.0f) {
+		gpuFrames--;
+	}
+	cpuHistory[next] = cpuMs;
+	gpuHistory[next] = gpuMs;
+	if (gpuMs >= 0.0f) {
+		gpuFrames++;
+	}
+	next = (next + 1) % HistorySize;
+	frames = std::min(frames + 1, HistorySize);
+	frameMilliseconds = frameMs;
+}
+
+
+void PerfOverlay::plotHistory(const char* label, const std::array<float, HistorySize>& history, int count) {
+	// Oldest first, frames without a time are left out of the statistics
+	// and drawn as 0
+	float total = 0.0f;
+	float peak = 0.0f;
+	int measured = 0;
+	std::array<float, HistorySize> values;
+	int first = (frames == HistorySize) ? next : 0;
+	for (int i = 0; i < count; i++) {
+		float value = history[(first + i) % HistorySize];
+		if (value >= 0.0f) {
+			total += value;
+			peak = std::max(peak, value);
+			measured++;
+		}
+		values[i] = std::max(value, 0.0f);
+	}
+	float average = measured ? total / measured : 0.0f;
+
+	char overlay[64];
+	std::snprintf(overlay, sizeof(overlay), "avg %.2f ms  max %.2f ms", average, peak);
+	// Fixed scale up to 30 fps so spikes stand out against the usual frame
+	float scale = std::max(33.3f, peak);
+	ImGui::PlotLines(label, values.data(), count, 0, overlay, 0.0f, scale, ImVec2(0.0f, 50.0f));
+}
+
+
+void PerfOverlay::draw(mountain& terrain, const GpuTimer& gpuTimer) {
+	if (!visible) {
+		return;
+	}
+
+	ImGui_ImplOpenGL3_NewFrame();
+	ImGui_ImplGlfw_NewFrame();
+	ImGui::NewFrame();
+
+	// Display only, the window callbacks keep all input
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_Always);
+	ImGui::SetNextWindowBgAlpha(0.6f);
+	ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize
+		| ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav
+		| ImGuiWindowFlags_NoInputs;
+	if (ImGui::Begin("Performance", nullptr, flags)) {
+		float fps = frameMilliseconds > 0.0f ? 1000.0f / frameMilliseconds : 0.0f;
+		ImGui::Text("Frame %.2f ms (%.0f fps)", frameMilliseconds, fps);
+		plotHistory("CPU", cpuHistory, frames);
+		if (gpuFrames > 0) {
+			plotHistory("GPU", gpuHistory, frames);
+			for (const GpuTimer::Result& result : gpuTimer.results()) {
+				if (result.milliseconds >= 0.0f) {
+					ImGui::Text("  %-10s %8.2f ms", result.pass.c_str(), result.milliseconds);
+				}
+			}
+		}
+		else {
+			ImGui::TextDisabled("GPU  not measured");
+		}
+
+		ImGui::Separator();
+		const TerrainTimings& timings = terrain.getLastTimings();
+		ImGui::Text("Last regen%s", terrain.isRegenerating() ? " (next one running)" : "");
+		ImGui::Text("  heights   %8.2f ms (%d threads)", milliseconds(timings.heights), timings.threads);
+		ImGui::Text("  grid      %8.2f ms%s", milliseconds(timings.grid), timings.gridReused ? " (reused)" : "");
+		ImGui::Text("  vertices  %8.2f ms", milliseconds(timings.vertices));
+		ImGui::Text("  finish    %8.2f ms", milliseconds(timings.finish));
+		ImGui::Text("  total     %8.2f ms", milliseconds(timings.total));
+		ImGui::Text("  present   %8.2f ms", milliseconds(timings.present));
+
+		ImGui::Separator();
+		const DrawStats::Frame& drawn = DrawStats::lastFrame();
+		ImGui::Text("Grid vertices  %d", (int)terrain.m_vertexCount);
+		ImGui::Text("Draw calls     %d", drawn.drawCalls);
+		ImGui::Text("Vertices       %zu", drawn.vertices);
+		ImGui::Text("Triangles      %zu", drawn.triangles);
+		if (drawn.points) {
+			ImGui::Text("Points         %zu", drawn.points);
+		}
+		if (drawn.patches) {
+			ImGui::Text("Patches        %zu", drawn.patches);
+		}
+		if (terrain._config.world) {
+			ImGui::Text("Tiles          %zu", terrain.getTileCount());
+		}
+
+		ImGui::Separator();
+		ImGui::Text("CPU memory  %8.2f MB", megabytes(terrain.cpuBytes()));
+		ImGui::Text("GPU memory  %8.2f MB", megabytes(terrain.gpuBytes()));
+	}
+	ImGui::End();
+
+	ImGui::Render();
+	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// ImGui overlay with frame time history, the stage timings of the terrain on
+// screen, what the last frame drew and the memory the terrain holds. Frames
+// are recorded while it is hidden too, so the history is there when it is
+// shown.
+//------------------------------------------------------------------------------
+
+#include "GpuTimer.h"
+#include "mountain.h"
+
+#include <array>
+
+
+class PerfOverlay {
+
+public:
+	PerfOverlay();
+
+	void toggle() { visible = !visible; }
+	bool isVisible() const { return visible; }
+
+	// Milliseconds between this frame and the last one, spent on it on the
+	// render thread and on the GPU. gpuMs < 0 when it wasn't measured.
+	void addFrame(float frameMs, float cpuMs, float gpuMs);
+
+	// Draws the overlay over the bound framebuffer when visible, last thing
+	// before swapping. Lists the passes gpuTimer times.
+	void draw(mountain& terrain, const GpuTimer& gpuTimer);
+
+private:
+	static constexpr int HistorySize = 240;
+
+	std::array<float, HistorySize> cpuHistory;
+	std::array<float, HistorySize> gpuHistory;
+	int next;       // slot the next frame goes to, the oldest one
+	int frames;     // recorded so far, up to HistorySize
+	int gpuFrames;  // of those with a GPU time
+	float frameMilliseconds;
+	bool visible;
+
+	void plotHistory(const char* label, const std::array<float, HistorySize>& history, int count);
+};
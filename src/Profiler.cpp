@@ -0,0 +1,219 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+	// Events kept per thread, 3 MB each
+	constexpr uint64_t Capacity = 1 << 16;
+
+	// One event of a ring buffer, guarded like a seqlock. sequence is
+	// 2 * index + 2 once event index is complete and odd while its owner
+	// writes it, so the exporter can tell a finished event from one that is
+	// being overwritten. The fields are atomics so reading one mid-write is
+	// no data race, just discarded.
+	struct Slot {
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> start{ 0 };
+		std::atomic<uint64_t> end{ 0 };
+		std::atomic<int64_t> value{ 0 };
+		std::atomic<uint32_t> type{ 0 };
+	};
+
+	struct ThreadBuffer {
+		std::vector<Slot> events;
+		std::atomic<uint64_t> written;   // events ever recorded, the next goes to written % Capacity
+		std::atomic<bool> retired;       // its thread ended, a new one may take it over
+		std::string name;                // guarded by the registry mutex
+		int id;
+
+		explicit ThreadBuffer(int id)
+			: events(Capacity), written(0), retired(false), name("thread " + std::to_string(id)), id(id)
+		{}
+	};
+
+	struct Registry {
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	};
+
+	Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	// Hands the buffer back when its thread ends
+	struct ThreadSlot {
+		ThreadBuffer* buffer = nullptr;
+
+		~ThreadSlot() {
+			if (buffer) {
+				buffer->retired.store(true);
+			}
+		}
+	};
+	thread_local ThreadSlot slot;
+
+	// Only the first event of a thread takes the lock
+	ThreadBuffer& threadBuffer()
+	{
+		if (!slot.buffer) {
+			Registry& reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			for (auto& buffer : reg.buffers) {
+				bool retired = true;
+				if (buffer->retired.compare_exchange_strong(retired, false)) {
+					// The old thread's events would show up under the new name
+					buffer->written.store(0, std::memory_order_relaxed);
+					buffer->name = "thread " + std::to_string(buffer->id);
+					slot.buffer = buffer.get();
+					break;
+				}
+			}
+			if (!slot.buffer) {
+				reg.buffers.push_back(std::make_unique<ThreadBuffer>((int)reg.buffers.size()));
+				slot.buffer = reg.buffers.back().get();
+			}
+		}
+		return *slot.buffer;
+	}
+
+	void push(const Profiler::Event& event)
+	{
+		// Single writer, the releases publish the event to the exporter
+		ThreadBuffer& buffer = threadBuffer();
+		uint64_t index = buffer.written.load(std::memory_order_relaxed);
+		Slot& slot = buffer.events[index % Capacity];
+		slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(event.name, std::memory_order_relaxed);
+		slot.start.store(event.start, std::memory_order_relaxed);
+		slot.end.store(event.end, std::memory_order_relaxed);
+		slot.value.store(event.value, std::memory_order_relaxed);
+		slot.type.store((uint32_t)event.type, std::memory_order_relaxed);
+		slot.sequence.store(2 * index + 2, std::memory_order_release);
+		buffer.written.store(index + 1, std::memory_order_release);
+	}
+
+	// Copy of event index of buffer, false when it was overwritten or is
+	// being written right now
+	bool read(const ThreadBuffer& buffer, uint64_t index, Profiler::Event& event)
+	{
+		const Slot& slot = buffer.events[index % Capacity];
+		uint64_t expected = 2 * index + 2;
+		if (slot.sequence.load(std::memory_order_acquire) != expected) {
+			return false;
+		}
+		event.name = slot.name.load(std::memory_order_relaxed);
+		event.start = slot.start.load(std::memory_order_relaxed);
+		event.end = slot.end.load(std::memory_order_relaxed);
+		event.value = slot.value.load(std::memory_order_relaxed);
+		event.type = (Profiler::EventType)slot.type.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return slot.sequence.load(std::memory_order_relaxed) == expected;
+	}
+}
+
+
+uint64_t Profiler::now()
+{
+	auto elapsed = std::chrono::steady_clock::now() - registry().epoch;
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+
+void Profiler::recordZone(const char* name, uint64_t start, uint64_t end)
+{
+	push(Event{ name, start, end, 0, EventType::Zone });
+}
+
+
+void Profiler::recordCount(const char* name, int64_t value)
+{
+	push(Event{ name, now(), 0, value, EventType::Count });
+}
+
+
+void Profiler::setThreadName(const std::string& name)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	std::lock_guard<std::mutex> lock(registry().mutex);
+	buffer.name = name;
+}
+
+
+bool Profiler::writeChromeTrace(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		return false;
+	}
+	out.setf(std::ios::fixed);
+	out.precision(3);
+
+	struct Count {
+		uint64_t time;
+		int64_t value;
+	};
+	std::map<std::string, std::vector<Count>> counts;
+
+	// Timestamps in microseconds
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	auto separator = [&]() {
+		out << (first ? "" : ",\n");
+		first = false;
+	};
+
+	Registry& reg = registry();
+	{
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		for (const auto& buffer : reg.buffers) {
+			separator();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+				<< ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+
+			uint64_t written = buffer->written.load(std::memory_order_acquire);
+			uint64_t begin = written > Capacity ? written - Capacity : 0;
+			for (uint64_t i = begin; i < written; i++) {
+				Profiler::Event event;
+				if (!read(*buffer, i, event)) {
+					continue;
+				}
+				if (event.type == EventType::Count) {
+					counts[event.name].push_back(Count{ event.start, event.value });
+					continue;
+				}
+				separator();
+				out << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+			}
+		}
+	}
+
+	// Counters are running totals over all threads
+	for (auto& entry : counts) {
+		std::vector<Count>& series = entry.second;
+		std::sort(series.begin(), series.end(), [](const Count& a, const Count& b) { return a.time < b.time; });
+		int64_t total = 0;
+		for (const Count& count : series) {
+			total += count.value;
+			separator();
+			out << "{\"name\":\"" << entry.first << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << count.time / 1000.0
+				<< ",\"args\":{\"value\":" << total << "}}";
+		}
+	}
+
+	out << "\n]}\n";
+	return (bool)out;
+}
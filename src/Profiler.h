@@ -0,0 +1,77 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Scoped profiling zones and counters, exported as a Chrome trace.
+//
+// PROFILE_ZONE("name") times the rest of the enclosing scope on the calling
+// thread, PROFILE_COUNT("name", n) adds n to a counter that is shown summed
+// over all threads. Every thread records into a ring buffer of its own that
+// only it writes to, so recording takes no locks. The newest events of every
+// thread are written out with Profiler::writeChromeTrace() and can be opened
+// in chrome://tracing or https://ui.perfetto.dev.
+//
+// Names have to be string literals, only the pointer is kept. Without
+// MOUNTAIN_PROFILE defined the macros compile to nothing.
+//------------------------------------------------------------------------------
+
+#include <cstdint>
+#include <string>
+
+
+namespace Profiler {
+
+	enum class EventType : uint32_t {
+		Zone,
+		Count
+	};
+
+	struct Event {
+		const char* name;
+		uint64_t start;   // nanoseconds since the profiler started
+		uint64_t end;     // zones only
+		int64_t value;    // counts only
+		EventType type;
+	};
+
+	// Current time on the profiler clock
+	uint64_t now();
+
+	void recordZone(const char* name, uint64_t start, uint64_t end);
+	void recordCount(const char* name, int64_t value);
+
+	// Shown as the thread's name in the trace
+	void setThreadName(const std::string& name);
+
+	// Writes the events still in the ring buffers. Threads keep recording
+	// meanwhile, events they overwrite during the export are left out.
+	// Returns false when the file can't be written.
+	bool writeChromeTrace(const std::string& path);
+
+	// Times its own lifetime
+	class Zone {
+	public:
+		explicit Zone(const char* name) : name(name), start(now()) {}
+		~Zone() { recordZone(name, start, now()); }
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* name;
+		uint64_t start;
+	};
+}
+
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef MOUNTAIN_PROFILE
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_COUNT(name, value) Profiler::recordCount(name, (int64_t)(value))
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNT(name, value) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#endif
@@ -0,0 +1,96 @@
+#include "RegenWorker.h"
+#include "Profiler.h"
+
+#include <utility>
+
+
+RegenWorker::RegenWorker(BuildFunction build)
+	: build(std::move(build))
+	, latest(0)
+	, pending()
+	, pendingTarget()
+	, hasPending(false)
+	, running(false)
+	, stopping(false)
+{
+	thread = std::thread(&RegenWorker::loop, this);
+}
+
+
+RegenWorker::~RegenWorker() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		hasPending = false;
+		latest++;
+	}
+	wake.notify_all();
+	thread.join();
+}
+
+
+void RegenWorker::request(const config& cfg, const TerrainTarget& target) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending = cfg;
+		pendingTarget = target;
+		hasPending = true;
+		// A build nobody took yet is stale, and the next one may be writing
+		// into the same mapped buffers
+		finished.reset();
+		// Cancels whatever is running
+		latest++;
+	}
+	wake.notify_one();
+}
+
+
+std::unique_ptr<TerrainBuild> RegenWorker::takeFinished() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return std::move(finished);
+}
+
+
+void RegenWorker::cancelAndWait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	hasPending = false;
+	latest++;
+	idle.wait(lock, [this] { return !running; });
+	finished.reset();
+}
+
+
+bool RegenWorker::busy() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return hasPending || running;
+}
+
+
+void RegenWorker::loop() {
+	PROFILE_THREAD_NAME("regen worker");
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		wake.wait(lock, [this] { return hasPending || stopping; });
+		if (stopping) {
+			return;
+		}
+
+		config cfg = pending;
+		TerrainTarget target = pendingTarget;
+		unsigned id = latest.load();
+		hasPending = false;
+		running = true;
+		lock.unlock();
+
+		std::unique_ptr<TerrainBuild> result = build(cfg, target, CancelToken(latest, id));
+
+		lock.lock();
+		running = false;
+		// Anything requested meanwhile makes this result stale
+		if (result && latest.load() == id) {
+			finished = std::move(result);
+		}
+		idle.notify_all();
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "CancelToken.h"
+#include "TerrainBuild.h"
+#include "config.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+// Runs terrain builds on a background thread so the render loop never waits
+// for them.
+//
+// Requests are coalesced: only the newest pending config gets built, and a
+// running build that a newer request overtakes sees its CancelToken fire and
+// its result is dropped. Finished builds are picked up with takeFinished().
+class RegenWorker {
+
+public:
+	// Returns null when it noticed the token was cancelled
+	using BuildFunction = std::function<std::unique_ptr<TerrainBuild>(
+		const config&, const TerrainTarget&, const CancelToken&)>;
+
+	explicit RegenWorker(BuildFunction build);
+	~RegenWorker();
+
+	// The thread can't be copied or moved
+	RegenWorker(const RegenWorker&) = delete;
+	RegenWorker& operator=(const RegenWorker&) = delete;
+
+	// Queues a build of cfg into target, replacing and cancelling older
+	// requests and dropping a finished build that wasn't taken yet. Never
+	// blocks on a running build.
+	void request(const config& cfg, const TerrainTarget& target);
+
+	// The newest finished build, or null when there is nothing new. When it
+	// returns one, no build is running.
+	std::unique_ptr<TerrainBuild> takeFinished();
+
+	// Drops pending and finished work and waits for a running build to
+	// notice, so the caller can build on its own thread
+	void cancelAndWait();
+
+	// A request is queued or being built
+	bool busy();
+
+private:
+	BuildFunction build;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+
+	// Id of the newest request, running builds compare theirs against it
+	std::atomic<unsigned> latest;
+
+	config pending;
+	TerrainTarget pendingTarget;
+	bool hasPending;
+	bool running;
+	bool stopping;
+	std::unique_ptr<TerrainBuild> finished;
+
+	void loop();
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Ridged multifractal kernels specialized on octave count and precision.
+//
+// The per-octave frequencies and amplitudes are worked out once per regen
+// (RidgedParams) and a kernel for the exact octave count is picked from a
+// table (selectRidgedKernel). Inside the kernel the octave loop is expanded at
+// compile time and the constants live in registers for a whole span of
+// samples. Octave counts beyond the table go through the generic loop.
+//------------------------------------------------------------------------------
+
+#include "SimplexNoise.h"
+#include "config.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+
+// Largest octave count with an unrolled kernel
+constexpr int MaxUnrolledOctaves = 12;
+
+
+template <typename Real>
+inline Real ridge(Real h, Real offset)
+{
+	h = offset - std::fabs(h);
+
+	if (h < Real(0.5)) {
+		// 4 * h^3
+		return Real(4) * h * h * h;
+	}
+	else {
+		// (h - 1) * (2h - 2)^2 + 1
+		Real term = (Real(2) * h - Real(2));
+		return (h - Real(1)) * term * term + Real(1);
+	}
+}
+
+
+// d ridge(h, offset) / dh, taking -1 as the slope of |h| at 0
+template <typename Real>
+inline Real ridgeSlope(Real h, Real offset)
+{
+	Real r = offset - std::fabs(h);
+	Real dr = (h < Real(0)) ? Real(1) : Real(-1);
+
+	// 12 r^2 below 0.5, 12 (r - 1)^2 above; both meet at 3
+	Real s = (r < Real(0.5)) ? r : r - Real(1);
+	return Real(12) * s * s * dr;
+}
+
+
+template <typename Real>
+struct RidgedParams {
+	int octaves = 0;
+	Real offset = 1;
+	std::vector<Real> frequency;
+	std::vector<Real> amplitude;
+
+	RidgedParams() = default;
+
+	explicit RidgedParams(const config& cfg)
+		: offset(cfg.ridgeOffset)
+	{
+		// config.octaves is a float, the loop runs while i < octaves
+		octaves = std::max(0, (int)std::ceil(cfg.octaves));
+
+		// Accumulated the same way the per-sample loop used to, so the
+		// float kernels reproduce its results exactly
+		Real freq = cfg.frequency;
+		Real amp = 0.5f;
+		for (int i = 0; i < octaves; i++) {
+			frequency.push_back(freq);
+			amplitude.push_back(amp);
+			freq *= Real(cfg.lacunarity);
+			amp *= Real(cfg.gain);
+		}
+	}
+};
+
+
+// out[k] = ridged multifractal at (xs[k], ys[k]) for k in [0, n)
+template <typename Real>
+using RidgedKernel = void (*)(const SimplexNoise& noise, const RidgedParams<Real>& params,
+	const Real* xs, const Real* ys, Real* out, int n);
+
+
+namespace ridged_detail {
+
+	template <typename Real>
+	inline void octave(const SimplexNoise& noise, Real x, Real y, Real offset,
+		Real freq, Real amp, Real& sum, Real& prev)
+	{
+		Real h = (Real)noise.noise2D(x * freq, y * freq);
+		Real n = ridge(h, offset);
+
+		sum += n * amp * prev;
+		prev = n;
+	}
+
+	template <typename Real, int... Octave>
+	void unrolled(const SimplexNoise& noise, const RidgedParams<Real>& params,
+		const Real* xs, const Real* ys, Real* out, int n, std::integer_sequence<int, Octave...>)
+	{
+		// Copy the constants out so that stores to out can't alias them
+		Real freq[] = { params.frequency[Octave]... };
+		Real amp[] = { params.amplitude[Octave]... };
+		const Real offset = params.offset;
+
+		for (int k = 0; k < n; k++) {
+			Real sum = 0;
+			Real prev = 1;
+			(octave(noise, xs[k], ys[k], offset, freq[Octave], amp[Octave], sum, prev), ...);
+			out[k] = sum;
+		}
+	}
+
+	template <int Octaves, typename Real>
+	void kernel(const SimplexNoise& noise, const RidgedParams<Real>& params,
+		const Real* xs, const Real* ys, Real* out, int n)
+	{
+		unrolled(noise, params, xs, ys, out, n, std::make_integer_sequence<int, Octaves>{});
+	}
+
+	// Entry i holds the kernel for i + 1 octaves
+	template <typename Real, int... Octaves>
+	constexpr std::array<RidgedKernel<Real>, sizeof...(Octaves)> table(std::integer_sequence<int, Octaves...>)
+	{
+		return { { &kernel<Octaves + 1, Real>... } };
+	}
+}
+
+
+// Generic fallback for any octave count
+template <typename Real>
+void ridgedMFGeneric(const SimplexNoise& noise, const RidgedParams<Real>& params,
+	const Real* xs, const Real* ys, Real* out, int n)
+{
+	for (int k = 0; k < n; k++) {
+		Real sum = 0;
+		Real prev = 1;
+		for (int i = 0; i < params.octaves; i++) {
+			ridged_detail::octave(noise, xs[k], ys[k], params.offset,
+				params.frequency[i], params.amplitude[i], sum, prev);
+		}
+		out[k] = sum;
+	}
+}
+
+
+// Ridged multifractal plus its gradient with respect to (x, y), carried
+// through the ridge and the octave weighting with the analytic noise
+// derivatives. out[k] matches the scalar kernels exactly.
+template <typename Real>
+void ridgedMFGradient(const SimplexNoise& noise, const RidgedParams<Real>& params,
+	const Real* xs, const Real* ys, Real* out, Real* dxs, Real* dys, int n)
+{
+	for (int k = 0; k < n; k++) {
+		Real sum = 0;
+		Real prev = 1;
+		Real sumDx = 0, sumDy = 0;
+		Real prevDx = 0, prevDy = 0;
+
+		for (int i = 0; i < params.octaves; i++) {
+			Real freq = params.frequency[i];
+			Real amp = params.amplitude[i];
+
+			double gx, gy;
+			Real h = (Real)noise.noise2D(xs[k] * freq, ys[k] * freq, gx, gy);
+			Real v = ridge(h, params.offset);
+
+			// Chain rule through the octave's frequency and ridge()
+			Real slope = ridgeSlope(h, params.offset);
+			Real vDx = slope * (Real)gx * freq;
+			Real vDy = slope * (Real)gy * freq;
+
+			sum += v * amp * prev;
+			sumDx += amp * (vDx * prev + v * prevDx);
+			sumDy += amp * (vDy * prev + v * prevDy);
+
+			prev = v;
+			prevDx = vDx;
+			prevDy = vDy;
+		}
+
+		out[k] = sum;
+		dxs[k] = sumDx;
+		dys[k] = sumDy;
+	}
+}
+
+
+// Picks the unrolled kernel for this octave count, or the generic one
+template <typename Real>
+RidgedKernel<Real> selectRidgedKernel(int octaves)
+{
+	static constexpr auto kernels = ridged_detail::table<Real>(
+		std::make_integer_sequence<int, MaxUnrolledOctaves>{});
+
+	if (octaves >= 1 && octaves <= MaxUnrolledOctaves) {
+		return kernels[octaves - 1];
+	}
+	return &ridgedMFGeneric<Real>;
+}
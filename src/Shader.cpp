@@ -1,6 +1,7 @@
 #include "Shader.h"
 
 #include "Log.h"
+#include "Profiler.h"
 
 #include <cstring>
 #include <fstream>
@@ -21,6 +22,7 @@ Shader::Shader(const std::string& path, GLenum type)
 }
 
 bool Shader::compile() {
+	PROFILE_ZONE("shader compile");
 
 	// read shader source
 	std::string sourceString;
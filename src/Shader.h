@@ -9,6 +9,7 @@
 #include <string>
 
 class ShaderProgram;
+class ComputeProgram;
 
 class Shader {
 
@@ -27,6 +28,7 @@ public:
 	GLenum getType() const { return type; }
 
 	void friend attach(ShaderProgram& sp, Shader& s);
+	void friend attach(ComputeProgram& cp, Shader& s);
 
 private:
 	ShaderHandle shaderID;
@@ -4,7 +4,9 @@
 #include <stdexcept>
 #include <vector>
 
+#include "GLTessellation.h"
 #include "Log.h"
+#include "Profiler.h"
 
 
 ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath)
@@ -12,7 +14,27 @@ ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& f
 	, vertex(vertexPath, GL_VERTEX_SHADER)
 	, fragment(fragmentPath, GL_FRAGMENT_SHADER)
 {
+	link();
+}
+
+ShaderProgram::ShaderProgram(const std::string& vertexPath, const std::string& tessControlPath,
+	const std::string& tessEvaluationPath, const std::string& fragmentPath)
+	: programID()
+	, vertex(vertexPath, GL_VERTEX_SHADER)
+	, fragment(fragmentPath, GL_FRAGMENT_SHADER)
+	, tessControl(std::make_unique<Shader>(tessControlPath, GL_TESS_CONTROL_SHADER))
+	, tessEvaluation(std::make_unique<Shader>(tessEvaluationPath, GL_TESS_EVALUATION_SHADER))
+{
+	link();
+}
+
+void ShaderProgram::link() {
+	PROFILE_ZONE("shader link");
 	attach(*this, vertex);
+	if (tessControl) {
+		attach(*this, *tessControl);
+		attach(*this, *tessEvaluation);
+	}
 	attach(*this, fragment);
 	glLinkProgram(programID);
 
@@ -26,8 +48,14 @@ bool ShaderProgram::recompile() {
 
 	try {
 		// Try to create a new program
-		ShaderProgram newProgram(vertex.getPath(), fragment.getPath());
-		*this = std::move(newProgram);
+		if (tessControl) {
+			ShaderProgram newProgram(vertex.getPath(), tessControl->getPath(), tessEvaluation->getPath(), fragment.getPath());
+			*this = std::move(newProgram);
+		}
+		else {
+			ShaderProgram newProgram(vertex.getPath(), fragment.getPath());
+			*this = std::move(newProgram);
+		}
 		return true;
 	}
 	catch (std::runtime_error &e) {
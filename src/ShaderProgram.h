@@ -8,6 +8,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <memory>
 #include <string>
 
 
@@ -15,6 +16,10 @@ class ShaderProgram {
 
 public:
 	ShaderProgram(const std::string& vertexPath, const std::string& fragmentPath);
+	// With tessellation control and evaluation stages in between, needs
+	// GLTessellation::available()
+	ShaderProgram(const std::string& vertexPath, const std::string& tessControlPath,
+		const std::string& tessEvaluationPath, const std::string& fragmentPath);
 
 	// Because we're using the ShaderProgramHandle to do RAII for the shader for us
 	// and our other types are trivial or provide their own RAII
@@ -38,6 +43,9 @@ private:
 
 	Shader vertex;
 	Shader fragment;
+	std::unique_ptr<Shader> tessControl;    // optional
+	std::unique_ptr<Shader> tessEvaluation; // optional
 
+	void link();
 	bool checkAndLogLinkSuccess() const;
 };
@@ -0,0 +1,423 @@
+#include "SimplexNoise.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMPLEX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX instructions inside functions that ask for them,
+// which keeps the rest of the program runnable on CPUs without them.
+// MSVC allows the intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMPLEX_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMPLEX_TARGET(isa)
+#endif
+
+//------------------------------------------------------------------------------
+// Batched noise kernels.
+//
+// All of them follow the same single precision recipe as noiseScalar() below.
+// Instead of branching on t0/t1/t2 every corner is evaluated and the ones
+// outside the kernel radius are masked to zero.
+//------------------------------------------------------------------------------
+
+namespace {
+
+	const float F2 = 0.36602540378443864676f; // 0.5 * (sqrt(3) - 1)
+	const float G2 = 0.21132486540518711775f; // (3 - sqrt(3)) / 6
+
+	// x and y components of SimplexNoise::grad3
+	alignas(64) const float gradX[12] = { 1, -1,  1, -1, 1, -1, 1, -1, 0,  0, 0,  0 };
+	alignas(64) const float gradY[12] = { 1,  1, -1, -1, 0,  0, 0,  0, 1, -1, 1, -1 };
+
+	struct Tables {
+		const int32_t* perm;
+		const int32_t* permMod12;
+	};
+
+	int fastFloor(float x) {
+		return (x >= 0) ? (int)x : (int)x - 1;
+	}
+
+	float corner(float x, float y, int gi) {
+		float t = std::max(0.5f - x * x - y * y, 0.0f);
+		t *= t;
+		return t * t * (gradX[gi] * x + gradY[gi] * y);
+	}
+
+	float noiseScalar(const Tables& tb, float xin, float yin) {
+		float s = (xin + yin) * F2;
+		int i = fastFloor(xin + s);
+		int j = fastFloor(yin + s);
+
+		float t = (float)(i + j) * G2;
+		float x0 = xin - ((float)i - t);
+		float y0 = yin - ((float)j - t);
+
+		int i1 = (x0 > y0) ? 1 : 0;
+		int j1 = 1 - i1;
+
+		float x1 = x0 - (float)i1 + G2;
+		float y1 = y0 - (float)j1 + G2;
+		float x2 = x0 - 1.0f + 2.0f * G2;
+		float y2 = y0 - 1.0f + 2.0f * G2;
+
+		int ii = i & 255;
+		int jj = j & 255;
+		int gi0 = tb.permMod12[ii + tb.perm[jj]];
+		int gi1 = tb.permMod12[ii + i1 + tb.perm[jj + j1]];
+		int gi2 = tb.permMod12[ii + 1 + tb.perm[jj + 1]];
+
+		float n0 = corner(x0, y0, gi0);
+		float n1 = corner(x1, y1, gi1);
+		float n2 = corner(x2, y2, gi2);
+		return 70.0f * (n0 + n1 + n2);
+	}
+
+	void batchScalar(const Tables& tb, const float* xs, const float* ys, float* out, size_t n) {
+		for (size_t k = 0; k < n; k++) {
+			out[k] = noiseScalar(tb, xs[k], ys[k]);
+		}
+	}
+
+#if defined(SIMPLEX_X86)
+
+	//--------------------------------------------------------------------------
+	// SSE2, 4 lanes. There is no gather, so the hashing is done per lane.
+	//--------------------------------------------------------------------------
+
+	SIMPLEX_TARGET("sse2")
+	__m128i floorSSE2(__m128 x) {
+		// Truncate, then subtract one where x < 0 (the mask is all ones = -1)
+		__m128i truncated = _mm_cvttps_epi32(x);
+		__m128i negative = _mm_castps_si128(_mm_cmplt_ps(x, _mm_setzero_ps()));
+		return _mm_add_epi32(truncated, negative);
+	}
+
+	SIMPLEX_TARGET("sse2")
+	__m128 cornerSSE2(__m128 x, __m128 y, __m128 gx, __m128 gy) {
+		__m128 t = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(x, x)), _mm_mul_ps(y, y));
+		t = _mm_max_ps(t, _mm_setzero_ps());
+		t = _mm_mul_ps(t, t);
+		__m128 dot = _mm_add_ps(_mm_mul_ps(gx, x), _mm_mul_ps(gy, y));
+		return _mm_mul_ps(_mm_mul_ps(t, t), dot);
+	}
+
+	SIMPLEX_TARGET("sse2")
+	void batchSSE2(const Tables& tb, const float* xs, const float* ys, float* out, size_t n) {
+		const __m128 f2 = _mm_set1_ps(F2);
+		const __m128 g2 = _mm_set1_ps(G2);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 g2x2 = _mm_set1_ps(2.0f * G2);
+
+		size_t k = 0;
+		for (; k + 4 <= n; k += 4) {
+			__m128 x = _mm_loadu_ps(xs + k);
+			__m128 y = _mm_loadu_ps(ys + k);
+
+			__m128 s = _mm_mul_ps(_mm_add_ps(x, y), f2);
+			__m128i i = floorSSE2(_mm_add_ps(x, s));
+			__m128i j = floorSSE2(_mm_add_ps(y, s));
+
+			__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i, j)), g2);
+			__m128 x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i), t));
+			__m128 y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j), t));
+
+			// Lower triangle (i1, j1) = (1, 0) where x0 > y0, else (0, 1)
+			__m128 lower = _mm_cmpgt_ps(x0, y0);
+			__m128 i1 = _mm_and_ps(lower, one);
+			__m128 j1 = _mm_andnot_ps(lower, one);
+
+			__m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), g2);
+			__m128 y1 = _mm_add_ps(_mm_sub_ps(y0, j1), g2);
+			__m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), g2x2);
+			__m128 y2 = _mm_add_ps(_mm_sub_ps(y0, one), g2x2);
+
+			alignas(16) int32_t iv[4], jv[4], lowerv[4];
+			_mm_store_si128((__m128i*)iv, i);
+			_mm_store_si128((__m128i*)jv, j);
+			_mm_store_si128((__m128i*)lowerv, _mm_castps_si128(lower));
+
+			alignas(16) float gx[3][4], gy[3][4];
+			for (int lane = 0; lane < 4; lane++) {
+				int ii = iv[lane] & 255;
+				int jj = jv[lane] & 255;
+				int li1 = lowerv[lane] ? 1 : 0;
+				int gi[3] = {
+					tb.permMod12[ii + tb.perm[jj]],
+					tb.permMod12[ii + li1 + tb.perm[jj + 1 - li1]],
+					tb.permMod12[ii + 1 + tb.perm[jj + 1]]
+				};
+				for (int c = 0; c < 3; c++) {
+					gx[c][lane] = gradX[gi[c]];
+					gy[c][lane] = gradY[gi[c]];
+				}
+			}
+
+			__m128 n0 = cornerSSE2(x0, y0, _mm_load_ps(gx[0]), _mm_load_ps(gy[0]));
+			__m128 n1 = cornerSSE2(x1, y1, _mm_load_ps(gx[1]), _mm_load_ps(gy[1]));
+			__m128 n2 = cornerSSE2(x2, y2, _mm_load_ps(gx[2]), _mm_load_ps(gy[2]));
+			__m128 sum = _mm_add_ps(_mm_add_ps(n0, n1), n2);
+			_mm_storeu_ps(out + k, _mm_mul_ps(_mm_set1_ps(70.0f), sum));
+		}
+
+		batchScalar(tb, xs + k, ys + k, out + k, n - k);
+	}
+
+	//--------------------------------------------------------------------------
+	// AVX2, 8 lanes, hashing through gathers
+	//--------------------------------------------------------------------------
+
+	SIMPLEX_TARGET("avx2")
+	__m256i floorAVX2(__m256 x) {
+		__m256i truncated = _mm256_cvttps_epi32(x);
+		__m256i negative = _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+		return _mm256_add_epi32(truncated, negative);
+	}
+
+	SIMPLEX_TARGET("avx2")
+	__m256 cornerAVX2(__m256 x, __m256 y, __m256i gi) {
+		__m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x, x)), _mm256_mul_ps(y, y));
+		t = _mm256_max_ps(t, _mm256_setzero_ps());
+		t = _mm256_mul_ps(t, t);
+		__m256 gx = _mm256_i32gather_ps(gradX, gi, 4);
+		__m256 gy = _mm256_i32gather_ps(gradY, gi, 4);
+		__m256 dot = _mm256_add_ps(_mm256_mul_ps(gx, x), _mm256_mul_ps(gy, y));
+		return _mm256_mul_ps(_mm256_mul_ps(t, t), dot);
+	}
+
+	SIMPLEX_TARGET("avx2")
+	void batchAVX2(const Tables& tb, const float* xs, const float* ys, float* out, size_t n) {
+		const __m256 f2 = _mm256_set1_ps(F2);
+		const __m256 g2 = _mm256_set1_ps(G2);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 g2x2 = _mm256_set1_ps(2.0f * G2);
+		const __m256i mask255 = _mm256_set1_epi32(255);
+		const __m256i oneInt = _mm256_set1_epi32(1);
+
+		size_t k = 0;
+		for (; k + 8 <= n; k += 8) {
+			__m256 x = _mm256_loadu_ps(xs + k);
+			__m256 y = _mm256_loadu_ps(ys + k);
+
+			__m256 s = _mm256_mul_ps(_mm256_add_ps(x, y), f2);
+			__m256i i = floorAVX2(_mm256_add_ps(x, s));
+			__m256i j = floorAVX2(_mm256_add_ps(y, s));
+
+			__m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(i, j)), g2);
+			__m256 x0 = _mm256_sub_ps(x, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+			__m256 y0 = _mm256_sub_ps(y, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+
+			__m256 lower = _mm256_cmp_ps(x0, y0, _CMP_GT_OQ);
+			__m256 i1 = _mm256_and_ps(lower, one);
+			__m256 j1 = _mm256_andnot_ps(lower, one);
+			__m256i i1Int = _mm256_and_si256(_mm256_castps_si256(lower), oneInt);
+			__m256i j1Int = _mm256_sub_epi32(oneInt, i1Int);
+
+			__m256 x1 = _mm256_add_ps(_mm256_sub_ps(x0, i1), g2);
+			__m256 y1 = _mm256_add_ps(_mm256_sub_ps(y0, j1), g2);
+			__m256 x2 = _mm256_add_ps(_mm256_sub_ps(x0, one), g2x2);
+			__m256 y2 = _mm256_add_ps(_mm256_sub_ps(y0, one), g2x2);
+
+			__m256i ii = _mm256_and_si256(i, mask255);
+			__m256i jj = _mm256_and_si256(j, mask255);
+
+			__m256i p0 = _mm256_i32gather_epi32(tb.perm, jj, 4);
+			__m256i p1 = _mm256_i32gather_epi32(tb.perm, _mm256_add_epi32(jj, j1Int), 4);
+			__m256i p2 = _mm256_i32gather_epi32(tb.perm, _mm256_add_epi32(jj, oneInt), 4);
+
+			__m256i gi0 = _mm256_i32gather_epi32(tb.permMod12, _mm256_add_epi32(ii, p0), 4);
+			__m256i gi1 = _mm256_i32gather_epi32(tb.permMod12, _mm256_add_epi32(_mm256_add_epi32(ii, i1Int), p1), 4);
+			__m256i gi2 = _mm256_i32gather_epi32(tb.permMod12, _mm256_add_epi32(_mm256_add_epi32(ii, oneInt), p2), 4);
+
+			__m256 n0 = cornerAVX2(x0, y0, gi0);
+			__m256 n1 = cornerAVX2(x1, y1, gi1);
+			__m256 n2 = cornerAVX2(x2, y2, gi2);
+			__m256 sum = _mm256_add_ps(_mm256_add_ps(n0, n1), n2);
+			_mm256_storeu_ps(out + k, _mm256_mul_ps(_mm256_set1_ps(70.0f), sum));
+		}
+
+		batchScalar(tb, xs + k, ys + k, out + k, n - k);
+	}
+
+	//--------------------------------------------------------------------------
+	// AVX-512, 16 lanes. Corners outside the kernel radius are masked off, so
+	// their gradient gathers are skipped as well.
+	//--------------------------------------------------------------------------
+
+	// GCC 12's AVX-512 headers trip -Wmaybe-uninitialized on their own
+	// _mm512_undefined_*() placeholders (GCC bug 105593)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+	SIMPLEX_TARGET("avx512f")
+	__m512i floorAVX512(__m512 x) {
+		__m512i truncated = _mm512_cvttps_epi32(x);
+		__mmask16 negative = _mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_LT_OQ);
+		return _mm512_mask_sub_epi32(truncated, negative, truncated, _mm512_set1_epi32(1));
+	}
+
+	SIMPLEX_TARGET("avx512f")
+	__m512 cornerAVX512(__m512 x, __m512 y, __m512i gi) {
+		__m512 t = _mm512_sub_ps(_mm512_sub_ps(_mm512_set1_ps(0.5f), _mm512_mul_ps(x, x)), _mm512_mul_ps(y, y));
+		__mmask16 inside = _mm512_cmp_ps_mask(t, _mm512_setzero_ps(), _CMP_GE_OQ);
+		t = _mm512_mul_ps(t, t);
+		__m512 gx = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inside, gi, gradX, 4);
+		__m512 gy = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), inside, gi, gradY, 4);
+		__m512 dot = _mm512_add_ps(_mm512_mul_ps(gx, x), _mm512_mul_ps(gy, y));
+		return _mm512_maskz_mul_ps(inside, _mm512_mul_ps(t, t), dot);
+	}
+
+	SIMPLEX_TARGET("avx512f")
+	void batchAVX512(const Tables& tb, const float* xs, const float* ys, float* out, size_t n) {
+		const __m512 f2 = _mm512_set1_ps(F2);
+		const __m512 g2 = _mm512_set1_ps(G2);
+		const __m512 one = _mm512_set1_ps(1.0f);
+		const __m512 g2x2 = _mm512_set1_ps(2.0f * G2);
+		const __m512i mask255 = _mm512_set1_epi32(255);
+		const __m512i oneInt = _mm512_set1_epi32(1);
+
+		size_t k = 0;
+		for (; k + 16 <= n; k += 16) {
+			__m512 x = _mm512_loadu_ps(xs + k);
+			__m512 y = _mm512_loadu_ps(ys + k);
+
+			__m512 s = _mm512_mul_ps(_mm512_add_ps(x, y), f2);
+			__m512i i = floorAVX512(_mm512_add_ps(x, s));
+			__m512i j = floorAVX512(_mm512_add_ps(y, s));
+
+			__m512 t = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_add_epi32(i, j)), g2);
+			__m512 x0 = _mm512_sub_ps(x, _mm512_sub_ps(_mm512_cvtepi32_ps(i), t));
+			__m512 y0 = _mm512_sub_ps(y, _mm512_sub_ps(_mm512_cvtepi32_ps(j), t));
+
+			__mmask16 lower = _mm512_cmp_ps_mask(x0, y0, _CMP_GT_OQ);
+			__mmask16 upper = (__mmask16)~lower;
+
+			__m512 x1 = _mm512_add_ps(_mm512_mask_sub_ps(x0, lower, x0, one), g2);
+			__m512 y1 = _mm512_add_ps(_mm512_mask_sub_ps(y0, upper, y0, one), g2);
+			__m512 x2 = _mm512_add_ps(_mm512_sub_ps(x0, one), g2x2);
+			__m512 y2 = _mm512_add_ps(_mm512_sub_ps(y0, one), g2x2);
+
+			__m512i ii = _mm512_and_si512(i, mask255);
+			__m512i jj = _mm512_and_si512(j, mask255);
+
+			__m512i p0 = _mm512_i32gather_epi32(jj, tb.perm, 4);
+			__m512i p1 = _mm512_i32gather_epi32(_mm512_mask_add_epi32(jj, upper, jj, oneInt), tb.perm, 4);
+			__m512i p2 = _mm512_i32gather_epi32(_mm512_add_epi32(jj, oneInt), tb.perm, 4);
+
+			__m512i gi0 = _mm512_i32gather_epi32(_mm512_add_epi32(ii, p0), tb.permMod12, 4);
+			__m512i gi1 = _mm512_i32gather_epi32(_mm512_add_epi32(_mm512_mask_add_epi32(ii, lower, ii, oneInt), p1), tb.permMod12, 4);
+			__m512i gi2 = _mm512_i32gather_epi32(_mm512_add_epi32(_mm512_add_epi32(ii, oneInt), p2), tb.permMod12, 4);
+
+			__m512 n0 = cornerAVX512(x0, y0, gi0);
+			__m512 n1 = cornerAVX512(x1, y1, gi1);
+			__m512 n2 = cornerAVX512(x2, y2, gi2);
+			__m512 sum = _mm512_add_ps(_mm512_add_ps(n0, n1), n2);
+			_mm512_storeu_ps(out + k, _mm512_mul_ps(_mm512_set1_ps(70.0f), sum));
+		}
+
+		batchScalar(tb, xs + k, ys + k, out + k, n - k);
+	}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // SIMPLEX_X86
+
+	SimplexNoise::SimdLevel detectSimdLevel() {
+		using Level = SimplexNoise::SimdLevel;
+#if defined(SIMPLEX_X86) && (defined(__GNUC__) || defined(__clang__))
+		// libgcc also checks that the OS saves the wider registers
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f")) return Level::AVX512;
+		if (__builtin_cpu_supports("avx2")) return Level::AVX2;
+		if (__builtin_cpu_supports("sse2")) return Level::SSE2;
+#elif defined(SIMPLEX_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+
+		// The OS has to save the YMM (and for AVX-512 the ZMM/opmask) state
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool avxState = (xcr0 & 0x06) == 0x06;
+		bool avx512State = (xcr0 & 0xE6) == 0xE6;
+
+		if (maxLeaf >= 7) {
+			__cpuidex(info, 7, 0);
+			if (avx512State && (info[1] & (1 << 16))) return Level::AVX512;
+			if (avxState && (info[1] & (1 << 5))) return Level::AVX2;
+		}
+		if (sse2) return Level::SSE2;
+#endif
+		return Level::Scalar;
+	}
+
+	SimplexNoise::SimdLevel hardwareSimdLevel() {
+		static const SimplexNoise::SimdLevel level = detectSimdLevel();
+		return level;
+	}
+}
+
+
+SimplexNoise::SimdLevel SimplexNoise::simdLevel() {
+	static const SimdLevel level = []() {
+		SimdLevel best = hardwareSimdLevel();
+
+		const char* requested = std::getenv("MOUNTAIN_SIMD");
+		if (requested != nullptr) {
+			for (SimdLevel candidate : { SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512 }) {
+				if (std::strcmp(requested, simdLevelName(candidate)) == 0) {
+					best = std::min(best, candidate);
+				}
+			}
+		}
+		return best;
+	}();
+	return level;
+}
+
+
+const char* SimplexNoise::simdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::SSE2:   return "sse2";
+	case SimdLevel::AVX2:   return "avx2";
+	case SimdLevel::AVX512: return "avx512";
+	default:                return "scalar";
+	}
+}
+
+
+void SimplexNoise::noise2D(SimdLevel level, const float* xs, const float* ys, float* out, size_t n) const {
+	Tables tables{ perm32.data(), permMod12_32.data() };
+
+	switch (std::min(level, hardwareSimdLevel())) {
+#if defined(SIMPLEX_X86)
+	case SimdLevel::AVX512:
+		batchAVX512(tables, xs, ys, out, n);
+		break;
+	case SimdLevel::AVX2:
+		batchAVX2(tables, xs, ys, out, n);
+		break;
+	case SimdLevel::SSE2:
+		batchSSE2(tables, xs, ys, out, n);
+		break;
+#endif
+	default:
+		batchScalar(tables, xs, ys, out, n);
+		break;
+	}
+}
@@ -4,9 +4,11 @@ https://cdnjs.cloudflare.com/ajax/libs/simplex-noise/2.4.0/simplex-noise.js
 (copyright in original code)
 */
 
-#include <vector>
+#pragma once
+
 #include <array>
 #include <random>
+#include <cstddef>
 #include <cstdint>
 #include <cmath>
 #include <algorithm>
@@ -14,6 +16,9 @@ https://cdnjs.cloudflare.com/ajax/libs/simplex-noise/2.4.0/simplex-noise.js
 
 class SimplexNoise {
 public:
+	// Instruction sets the batched noise2D() can run on, widest last
+	enum class SimdLevel { Scalar, SSE2, AVX2, AVX512 };
+
 	// Constructors:
 	explicit SimplexNoise(unsigned seed = std::random_device{}())
 	{
@@ -22,7 +27,6 @@ public:
 		std::uniform_int_distribution<> dist(0, 255);
 
 		// 1) Fill p with 0..255
-		p.resize(256);
 		for (int i = 0; i < 256; ++i) {
 			p[i] = static_cast<uint8_t>(i);
 		}
@@ -34,12 +38,14 @@ public:
 		}
 
 		// 3) Populate perm and permMod12
-		perm.resize(512);
-		permMod12.resize(512);
 		for (int i = 0; i < 512; i++) {
 			perm[i] = p[i & 255];
 			permMod12[i] = perm[i] % 12;
 		}
+
+		// 4) 32-bit copies for the gather instructions of the batched path
+		std::copy(perm.begin(), perm.end(), perm32.begin());
+		std::copy(permMod12.begin(), permMod12.end(), permMod12_32.begin());
 	}
 
 	// 2D noise
@@ -109,10 +115,101 @@ public:
 		return 70.0 * (n0 + n1 + n2);
 	}
 
+	// 2D noise and its analytic gradient (dN/dx, dN/dy). The value is
+	// exactly the one noise2D(xin, yin) returns.
+	double noise2D(double xin, double yin, double& dx, double& dy) const
+	{
+		// Skewing/Unskewing factors for 2D
+		static const double F2 = 0.5 * (std::sqrt(3.0) - 1.0);
+		static const double G2 = (3.0 - std::sqrt(3.0)) / 6.0;
+
+		// Skew the input space to determine which simplex cell we're in
+		double s = (xin + yin) * F2;
+		int i = fastFloor(xin + s);
+		int j = fastFloor(yin + s);
+
+		double t = (i + j) * G2;
+		double x0 = xin - (i - t);
+		double y0 = yin - (j - t);
+
+		// Determine which simplex we are in
+		int i1 = (x0 > y0) ? 1 : 0;
+		int j1 = 1 - i1;
+
+		// Offsets for corners
+		double x1 = x0 - i1 + G2;
+		double y1 = y0 - j1 + G2;
+		double x2 = x0 - 1.0 + 2.0 * G2;
+		double y2 = y0 - 1.0 + 2.0 * G2;
+
+		int ii = i & 255;
+		int jj = j & 255;
+
+		// Each corner adds t^4 (g . d) with t = 0.5 - |d|^2, whose gradient
+		// is t^4 g - 8 t^3 (g . d) d
+		dx = 0.0;
+		dy = 0.0;
+		auto corner = [&](double x, double y, int gi) {
+			double t = 0.5 - x * x - y * y;
+			if (t < 0) {
+				return 0.0;
+			}
+			double gx = grad3[gi * 3 + 0];
+			double gy = grad3[gi * 3 + 1];
+			double dot = gx * x + gy * y;
+			double t2 = t * t;
+			double t4 = t2 * t2;
+
+			dx += t4 * gx - 8.0 * t2 * t * dot * x;
+			dy += t4 * gy - 8.0 * t2 * t * dot * y;
+			return t4 * dot;
+		};
+
+		double n0 = corner(x0, y0, permMod12[ii + perm[jj]]);
+		double n1 = corner(x1, y1, permMod12[ii + i1 + perm[jj + j1]]);
+		double n2 = corner(x2, y2, permMod12[ii + 1 + perm[jj + 1]]);
+
+		// Sum up and scale the result
+		dx *= 70.0;
+		dy *= 70.0;
+		return 70.0 * (n0 + n1 + n2);
+	}
+
+	// Batched 2D noise: out[k] = noise2D(xs[k], ys[k]) for k in [0, n).
+	//
+	// Evaluated in single precision, SIMD lanes at a time, on the widest
+	// instruction set the CPU supports (see simdLevel()). Every level,
+	// including the scalar fallback, agrees with the double precision
+	// noise2D() to within 1e-5 absolute for inputs of magnitude up to 10,
+	// 1e-4 up to 100 and 5e-4 up to 1000 (the octaves terrain generation
+	// uses stay below that). Precision keeps degrading with larger inputs
+	// as float runs out of fractional bits.
+	void noise2D(const float* xs, const float* ys, float* out, size_t n) const
+	{
+		noise2D(simdLevel(), xs, ys, out, n);
+	}
+
+	// Same as above on an explicit instruction set. Levels the CPU doesn't
+	// support fall back to the best one it does.
+	void noise2D(SimdLevel level, const float* xs, const float* ys, float* out, size_t n) const;
+
+	// Widest instruction set supported by this CPU and OS. The environment
+	// variable MOUNTAIN_SIMD (scalar, sse2, avx2, avx512) can lower it.
+	static SimdLevel simdLevel();
+	static const char* simdLevelName(SimdLevel level);
+
+	// The seeded tables as 32-bit ints, for copies of the noise on the GPU
+	const std::array<int32_t, 512>& permutation() const { return perm32; }
+	const std::array<int32_t, 512>& permutationMod12() const { return permMod12_32; }
+
 private:
-	std::vector<uint8_t> p;
-	std::vector<uint8_t> perm;
-	std::vector<uint8_t> permMod12;
+	// Fixed-size tables keep the object self-contained, copying it never
+	// allocates
+	std::array<uint8_t, 256> p;
+	std::array<uint8_t, 512> perm;
+	std::array<uint8_t, 512> permMod12;
+	std::array<int32_t, 512> perm32;
+	std::array<int32_t, 512> permMod12_32;
 
 	// Fast floor
 	static int fastFloor(double x) {
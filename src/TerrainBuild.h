@@ -0,0 +1,82 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// CPU side results of a terrain regen. They are produced without touching GL,
+// so a build can run on any thread, and mountain uploads them afterwards.
+//------------------------------------------------------------------------------
+
+#include "config.h"
+#include "Vertex.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+struct TerrainLODTree;
+
+
+// Index buffer and texture coordinates of the grid. They only depend on the
+// subdivisions and the vertex format, so builds share them until one changes.
+struct TerrainGrid {
+	int subdivisions = -1;
+	int vertexFormat = -1;
+	std::vector<unsigned int> indices;  // empty for vertexFormat 3, it draws TerrainLOD patches
+	std::vector<glm::vec2> texCoords;   // vertexFormat 0 only
+};
+
+
+// GPU buffer memory a build fills in directly, mapped by mountain on the GL
+// thread. Empty when the build keeps its vertices in the vectors instead.
+struct TerrainTarget {
+	int vertexFormat = -1;
+	size_t vertexCount = 0;
+	glm::vec3* verts = nullptr;              // vertexFormat 0
+	glm::vec3* normals = nullptr;            // vertexFormat 0
+	PackedTerrainVertex* packed = nullptr;   // vertexFormat 1
+
+	bool empty() const { return vertexFormat < 0; }
+
+	bool fits(const config& cfg) const {
+		size_t gridSize = (size_t)cfg.subdivisions + 1;
+		return !empty() && vertexFormat == cfg.vertexFormat && vertexCount == gridSize * gridSize;
+	}
+};
+
+
+// Seconds spent in the stages of a build, 0 for stages that didn't run
+struct TerrainTimings {
+	double heights = 0.0;   // noise, noise cache or tile store
+	double grid = 0.0;      // indices and texcoords, 0 when reused
+	double vertices = 0.0;  // positions and normals
+	double finish = 0.0;    // bounds, tile store and packing
+	double total = 0.0;     // the whole build, on the GPU for compute builds
+	double present = 0.0;   // upload and swap in on the GL thread
+	int threads = 0;
+	bool gridReused = false;
+};
+
+
+struct TerrainBuild {
+	config cfg;
+	std::shared_ptr<const TerrainGrid> grid;
+	std::vector<float> heights;         // (subdivisions+1)^2, row by row
+	std::shared_ptr<const TerrainLODTree> lodTree; // vertexFormat 3 only
+	TerrainTarget target;               // where the vertices went, if mapped
+
+	// Only filled when there is no target
+	std::vector<glm::vec3> verts;       // not for vertexFormats 2 and 3
+	std::vector<glm::vec3> normals;     // not for vertexFormats 2 and 3
+	std::vector<PackedTerrainVertex> packed; // vertexFormat 1 only
+	glm::vec2 heightRange = glm::vec2(0.0f); // minimum height, max - min
+
+	// Generated by TerrainCompute straight into the back slot, nothing to
+	// upload. heights is only filled with keepCpuGeometry.
+	bool onGpu = false;
+
+	// Heights, and normals when set, were loaded from the TileStore
+	bool fromStore = false;
+	bool normalsLoaded = false;
+
+	TerrainTimings timings;
+};
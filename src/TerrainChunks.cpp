@@ -0,0 +1,117 @@
+#include "TerrainChunks.h"
+
+#include <algorithm>
+
+
+TerrainChunks::TerrainChunks()
+	: subdivisions(0)
+	, chunkCount(0)
+{}
+
+
+void TerrainChunks::cull(const TerrainLODTree& tree, glm::vec2 terrainSize, const Frustum& frustum)
+{
+	visible.clear();
+	subdivisions = tree.subdivisions;
+
+	int chunksPerSide = (subdivisions + TerrainLODTree::PatchSize - 1) / TerrainLODTree::PatchSize;
+	chunkCount = (size_t)chunksPerSide * chunksPerSide;
+
+	collect(tree, terrainSize, frustum, tree.levels - 1, 0, 0, false);
+
+	// Row by row, so that neighbouring chunks end up next to each other
+	std::sort(visible.begin(), visible.end(), [](glm::ivec2 a, glm::ivec2 b) {
+		return a.y != b.y ? a.y < b.y : a.x < b.x;
+	});
+}
+
+
+void TerrainChunks::collect(const TerrainLODTree& tree, glm::vec2 terrainSize, const Frustum& frustum,
+	int level, int x, int y, bool inside)
+{
+	glm::vec3 low, high;
+	if (!tree.nodeBox(level, x, y, terrainSize, low, high)) {
+		return;
+	}
+
+	// Everything below a node that is fully inside is visible as well
+	if (!inside) {
+		Frustum::Containment containment = frustum.classify(low, high);
+		if (containment == Frustum::Containment::Outside) {
+			return;
+		}
+		inside = containment == Frustum::Containment::Inside;
+	}
+
+	if (level == 0) {
+		visible.push_back(glm::ivec2(x, y));
+		return;
+	}
+	for (int q = 0; q < 4; q++) {
+		collect(tree, terrainSize, frustum, level - 1, x * 2 + (q & 1), y * 2 + (q >> 1), inside);
+	}
+}
+
+
+void TerrainChunks::addRange(GLint first, GLsizei count)
+{
+	if (!firsts.empty() && firsts.back() + counts.back() == first) {
+		counts.back() += count;
+		return;
+	}
+	firsts.push_back(first);
+	counts.push_back(count);
+}
+
+
+void TerrainChunks::draw(GPU_Geometry& geom, GLenum mode)
+{
+	constexpr int PatchSize = TerrainLODTree::PatchSize;
+	int stride = subdivisions + 1;
+	bool points = mode == GL_POINTS;
+
+	firsts.clear();
+	counts.clear();
+
+	size_t begin = 0;
+	while (begin < visible.size()) {
+		// Run of neighbouring chunks in the same chunk row
+		size_t end = begin + 1;
+		while (end < visible.size() && visible[end].y == visible[begin].y && visible[end].x == visible[end - 1].x + 1) {
+			end++;
+		}
+
+		int col0 = visible[begin].x * PatchSize;
+		int col1 = std::min(visible[end - 1].x * PatchSize + PatchSize, subdivisions);
+		int row0 = visible[begin].y * PatchSize;
+		int row1 = std::min(row0 + PatchSize, subdivisions);
+
+		if (points) {
+			// Vertices on a chunk border belong to the chunk after it, the
+			// last ones of the grid to the last chunk
+			int colEnd = (col1 == subdivisions) ? col1 + 1 : col1;
+			int rowEnd = (row1 == subdivisions) ? row1 + 1 : row1;
+			for (int row = row0; row < rowEnd; row++) {
+				addRange(row * stride + col0, colEnd - col0);
+			}
+		}
+		else {
+			// Quads are six indices each, row by row
+			for (int row = row0; row < row1; row++) {
+				addRange((row * subdivisions + col0) * 6, (col1 - col0) * 6);
+			}
+		}
+
+		begin = end;
+	}
+
+	if (firsts.empty()) {
+		return;
+	}
+	if (points) {
+		geom.drawArrays(mode, firsts, counts);
+	}
+	else {
+		geom.drawElements(mode, firsts, counts);
+	}
+}
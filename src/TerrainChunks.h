@@ -0,0 +1,53 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// View frustum culling for the formats that draw the whole grid (vertexFormats
+// 0 to 2).
+//
+// The grid is split into the PatchSize x PatchSize cell chunks of the level 0
+// TerrainLODTree nodes, whose height bounds come with every build. The tree is
+// walked top down against the frustum, so whole quadrants are accepted or
+// dropped with one test. The index buffer stays row by row, and every visible
+// run of chunks turns into one index range per grid row. Ranges that meet are
+// merged, and everything goes to the GPU in a single multi-draw.
+//------------------------------------------------------------------------------
+
+#include "Frustum.h"
+#include "Geometry.h"
+#include "TerrainLOD.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+class TerrainChunks {
+
+public:
+	TerrainChunks();
+
+	// Collects the chunks of the tree that intersect the frustum, for a
+	// terrain of terrainSize world units
+	void cull(const TerrainLODTree& tree, glm::vec2 terrainSize, const Frustum& frustum);
+
+	// Draws the visible chunks of the grid in geom. Its index buffer has to
+	// be the row by row grid of the tree's subdivisions. GL_POINTS draws the
+	// chunk vertices without indices.
+	void draw(GPU_Geometry& geom, GLenum mode);
+
+	size_t getVisibleCount() const { return visible.size(); }
+	size_t getChunkCount() const { return chunkCount; }
+
+private:
+	std::vector<glm::ivec2> visible; // level 0 nodes, row by row after cull()
+	int subdivisions;
+	size_t chunkCount;
+
+	// Ranges of the last draw, in indices or in vertices for points
+	std::vector<GLint> firsts;
+	std::vector<GLsizei> counts;
+
+	void collect(const TerrainLODTree& tree, glm::vec2 terrainSize, const Frustum& frustum,
+		int level, int x, int y, bool inside);
+	void addRange(GLint first, GLsizei count);
+};
@@ -0,0 +1,173 @@
+#include "TerrainCompute.h"
+
+#include "GLCompute.h"
+#include "Heightfield.h"
+#include "Log.h"
+#include "RidgedMF.h"
+#include "SimplexNoise.h"
+#include "TerrainLOD.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace {
+	// local_size of the shaders
+	constexpr GLuint GridGroupSize = 16;
+	constexpr GLuint BoundsGroupSize = 8;
+
+	// Storage buffer bindings shared with the shaders
+	constexpr GLuint HeightBinding = 0;
+	constexpr GLuint PermutationBinding = 1;
+	constexpr GLuint OctaveBinding = 2;
+	constexpr GLuint PositionBinding = 3;
+	constexpr GLuint NormalBinding = 4;
+	constexpr GLuint BoundsBinding = 5;
+
+	GLuint groups(int count, GLuint groupSize) {
+		return ((GLuint)count + groupSize - 1) / groupSize;
+	}
+
+	void setGridUniforms(GLuint program, const config& cfg) {
+		glUniform1i(glGetUniformLocation(program, "subdivisions"), cfg.subdivisions);
+		glUniform1i(glGetUniformLocation(program, "width"), cfg.width);
+		glUniform1i(glGetUniformLocation(program, "height"), cfg.height);
+	}
+}
+
+
+TerrainCompute::TerrainCompute()
+	: loaded(false)
+	, failed(false)
+{}
+
+
+bool TerrainCompute::ready()
+{
+	if (loaded || failed) {
+		return loaded;
+	}
+	if (!GLCompute::available()) {
+		failed = true;
+		return false;
+	}
+
+	try {
+		heightProgram = std::make_unique<ComputeProgram>("shaders/terrain_heights.comp");
+		vertexProgram = std::make_unique<ComputeProgram>("shaders/terrain_vertices.comp");
+		boundsProgram = std::make_unique<ComputeProgram>("shaders/terrain_bounds.comp");
+		loaded = true;
+	}
+	catch (std::runtime_error&) {
+		Log::warn("COMPUTE terrain shaders did not build, generating on the CPU");
+		heightProgram.reset();
+		vertexProgram.reset();
+		boundsProgram.reset();
+		failed = true;
+	}
+	return loaded;
+}
+
+
+bool TerrainCompute::recompile()
+{
+	if (failed) {
+		failed = false;
+		return ready();
+	}
+	if (!loaded) {
+		return false;
+	}
+	// All of them, even after one failed
+	bool heights = heightProgram->recompile();
+	bool vertices = vertexProgram->recompile();
+	bool bounds = boundsProgram->recompile();
+	return heights || vertices || bounds;
+}
+
+
+bool TerrainCompute::supports(const config& cfg) const
+{
+	if (cfg.vertexFormat == 1 || cfg.subdivisions < 1) {
+		return false;
+	}
+
+	// Every buffer is one storage block, the positions and normals are the
+	// largest ones
+	GLint64 gridSize = (GLint64)cfg.subdivisions + 1;
+	GLint64 largest = gridSize * gridSize * (GLint64)((cfg.vertexFormat == 0) ? sizeof(glm::vec3) : sizeof(float));
+	return largest <= GLCompute::maxStorageBlockSize();
+}
+
+
+std::vector<glm::vec2> TerrainCompute::generate(const config& cfg, GPU_Geometry& geom, HeightTexture& heightTexture)
+{
+	int gridSize = cfg.subdivisions + 1;
+	size_t vertexCount = (size_t)gridSize * gridSize;
+
+	// The CPU tables and octave constants, so both sides evaluate the same
+	// noise
+	SimplexNoise noise(cfg.seed);
+	std::vector<GLint> tables(noise.permutation().begin(), noise.permutation().end());
+	tables.insert(tables.end(), noise.permutationMod12().begin(), noise.permutationMod12().end());
+	permutation.uploadData(sizeof(GLint) * tables.size(), tables.data(), GL_STATIC_DRAW);
+	permutation.bindStorage(PermutationBinding, sizeof(GLint) * tables.size(), GL_STATIC_DRAW);
+
+	RidgedParams<float> params(cfg);
+	std::vector<glm::vec2> octaveData(std::max(params.octaves, 1), glm::vec2(0.0f));
+	for (int i = 0; i < params.octaves; i++) {
+		octaveData[i] = glm::vec2(params.frequency[i], params.amplitude[i]);
+	}
+	octaves.uploadData(sizeof(glm::vec2) * octaveData.size(), octaveData.data(), GL_STATIC_DRAW);
+	octaves.bindStorage(OctaveBinding, sizeof(glm::vec2) * octaveData.size(), GL_STATIC_DRAW);
+
+	heights.bindStorage(HeightBinding, sizeof(float) * vertexCount, GL_DYNAMIC_COPY);
+
+	// One invocation per grid vertex
+	heightProgram->use();
+	setGridUniforms(*heightProgram, cfg);
+	glUniform1i(glGetUniformLocation(*heightProgram, "octaveCount"), params.octaves);
+	glUniform1f(glGetUniformLocation(*heightProgram, "ridgeOffset"), params.offset);
+	glUniform1f(glGetUniformLocation(*heightProgram, "heightScale"), HeightfieldSampler::HeightScale);
+	GLCompute::dispatch(groups(gridSize, GridGroupSize), groups(gridSize, GridGroupSize), 1);
+	GLCompute::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+
+	if (cfg.vertexFormat == 0) {
+		geom.bindVertexStorage(vertexCount, PositionBinding, NormalBinding);
+
+		vertexProgram->use();
+		setGridUniforms(*vertexProgram, cfg);
+		glUniform1i(glGetUniformLocation(*vertexProgram, "normalMode"), cfg.normalMode);
+		GLCompute::dispatch(groups(gridSize, GridGroupSize), groups(gridSize, GridGroupSize), 1);
+		GLCompute::memoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+	else {
+		// Buffer to texture copy, the heights never leave the GPU
+		heights.bindAs(GL_PIXEL_UNPACK_BUFFER);
+		heightTexture.upload(gridSize, nullptr);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	int leaves = lodTreeLeavesPerSide(cfg.subdivisions);
+	std::vector<glm::vec2> leafBounds((size_t)leaves * leaves);
+	bounds.bindStorage(BoundsBinding, sizeof(glm::vec2) * leafBounds.size(), GL_DYNAMIC_READ);
+
+	boundsProgram->use();
+	glUniform1i(glGetUniformLocation(*boundsProgram, "subdivisions"), cfg.subdivisions);
+	glUniform1i(glGetUniformLocation(*boundsProgram, "patchSize"), TerrainLODTree::PatchSize);
+	glUniform1i(glGetUniformLocation(*boundsProgram, "leavesPerSide"), leaves);
+	GLCompute::dispatch(groups(leaves, BoundsGroupSize), groups(leaves, BoundsGroupSize), 1);
+	GLCompute::memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	bounds.readData(0, sizeof(glm::vec2) * leafBounds.size(), leafBounds.data());
+	return leafBounds;
+}
+
+
+std::vector<float> TerrainCompute::readHeights(const config& cfg) const
+{
+	size_t gridSize = (size_t)cfg.subdivisions + 1;
+	std::vector<float> result(gridSize * gridSize);
+	heights.readData(0, sizeof(float) * result.size(), result.data());
+	return result;
+}
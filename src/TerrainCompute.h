@@ -0,0 +1,65 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Terrain generation in compute shaders (config generator 1), GL 4.3 and up.
+//
+// terrain_heights.comp evaluates the same simplex noise, ridged multifractal
+// and falloff as HeightfieldSampler, one invocation per grid vertex, into a
+// storage buffer. From there a second dispatch writes the positions and
+// normals of vertexFormat 0 straight into the vertex buffers, or the buffer
+// is copied into the height texture of vertexFormats 2 to 4 without leaving
+// the GPU. Only the level 0 chunk bounds come back to the CPU for culling and
+// the LOD tree.
+//------------------------------------------------------------------------------
+
+#include "ComputeProgram.h"
+#include "config.h"
+#include "Geometry.h"
+#include "HeightTexture.h"
+#include "VertexBuffer.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+
+class TerrainCompute {
+
+public:
+	TerrainCompute();
+
+	// Builds the compute programs on first use. False when the context has no
+	// compute shaders or they didn't build, callers generate on the CPU then.
+	bool ready();
+
+	// Rebuilds the programs from their files after they changed. Programs
+	// that fail keep their previous version, a generator that never built
+	// is tried again on the next ready(). False when nothing changed.
+	bool recompile();
+
+	// The packed format and grids past the storage block limit stay on the
+	// CPU
+	bool supports(const config& cfg) const;
+
+	// Generates the heights of cfg and whatever its vertex format draws from:
+	// positions and normals in geom for vertexFormat 0, heightTexture for
+	// vertexFormats 2 to 4. Returns the bounds of the level 0 LOD tree nodes,
+	// see buildLODTree().
+	std::vector<glm::vec2> generate(const config& cfg, GPU_Geometry& geom, HeightTexture& heightTexture);
+
+	// Heights of the last generate(), row by row. Waits for the GPU.
+	std::vector<float> readHeights(const config& cfg) const;
+
+private:
+	std::unique_ptr<ComputeProgram> heightProgram;
+	std::unique_ptr<ComputeProgram> vertexProgram;
+	std::unique_ptr<ComputeProgram> boundsProgram;
+	bool loaded;
+	bool failed;
+
+	VertexBuffer heights;     // binding 0, (subdivisions+1)^2 floats
+	VertexBuffer permutation; // binding 1, perm and permMod12
+	VertexBuffer octaves;     // binding 2, frequency and amplitude per octave
+	VertexBuffer bounds;      // binding 5, min and max per level 0 node
+};
@@ -0,0 +1,286 @@
+#include "TerrainLOD.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+
+namespace {
+	// Fraction of the way from the previous level's range to its own where a
+	// level starts morphing into the next coarser one
+	constexpr float MorphStart = 0.7f;
+
+	constexpr int AllQuadrants = 15;
+
+	// Smallest root that covers the grid, nodes past the border stay empty
+	int treeLevels(int subdivisions)
+	{
+		int levels = 1;
+		while ((TerrainLODTree::PatchSize << (levels - 1)) < subdivisions) {
+			levels++;
+		}
+		return levels;
+	}
+}
+
+
+std::shared_ptr<const TerrainLODTree> buildLODTree(int subdivisions, const std::vector<float>& heights, ThreadPool& workers)
+{
+	constexpr int PatchSize = TerrainLODTree::PatchSize;
+	int stride = subdivisions + 1;
+
+	// Leaves straight from the heights, including the shared border vertices
+	int leaves = lodTreeLeavesPerSide(subdivisions);
+	std::vector<glm::vec2> leafBounds(leaves * leaves);
+	workers.parallelFor(0, leaves, [&](int begin, int end) {
+		for (int y = begin; y < end; y++) {
+			for (int x = 0; x < leaves; x++) {
+				glm::vec2 bounds(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+				int col0 = x * PatchSize;
+				int row0 = y * PatchSize;
+				if (col0 < subdivisions && row0 < subdivisions) {
+					int col1 = std::min(col0 + PatchSize, subdivisions);
+					int row1 = std::min(row0 + PatchSize, subdivisions);
+					for (int row = row0; row <= row1; row++) {
+						for (int col = col0; col <= col1; col++) {
+							float h = heights[row * stride + col];
+							bounds.x = std::min(bounds.x, h);
+							bounds.y = std::max(bounds.y, h);
+						}
+					}
+				}
+				leafBounds[y * leaves + x] = bounds;
+			}
+		}
+	});
+
+	return buildLODTree(subdivisions, std::move(leafBounds));
+}
+
+
+int lodTreeLeavesPerSide(int subdivisions)
+{
+	return 1 << (treeLevels(subdivisions) - 1);
+}
+
+
+std::shared_ptr<const TerrainLODTree> buildLODTree(int subdivisions, std::vector<glm::vec2> leafBounds)
+{
+	auto tree = std::make_shared<TerrainLODTree>();
+	tree->subdivisions = subdivisions;
+	tree->levels = treeLevels(subdivisions);
+	tree->bounds.resize(tree->levels);
+	tree->bounds[0] = std::move(leafBounds);
+
+	// Every other level from the four children below it
+	for (int level = 1; level < tree->levels; level++) {
+		int nodes = tree->nodesPerSide(level);
+		std::vector<glm::vec2>& levelBounds = tree->bounds[level];
+		levelBounds.resize(nodes * nodes);
+		for (int y = 0; y < nodes; y++) {
+			for (int x = 0; x < nodes; x++) {
+				glm::vec2 bounds = tree->nodeBounds(level - 1, x * 2, y * 2);
+				for (int q = 1; q < 4; q++) {
+					glm::vec2 child = tree->nodeBounds(level - 1, x * 2 + (q & 1), y * 2 + (q >> 1));
+					bounds.x = std::min(bounds.x, child.x);
+					bounds.y = std::max(bounds.y, child.y);
+				}
+				levelBounds[y * nodes + x] = bounds;
+			}
+		}
+	}
+
+	return tree;
+}
+
+
+bool TerrainLODTree::nodeBox(int level, int x, int y, glm::vec2 terrainSize, glm::vec3& low, glm::vec3& high) const
+{
+	glm::vec2 heights = nodeBounds(level, x, y);
+	if (heights.x > heights.y) {
+		return false;
+	}
+
+	// Grid cells covered by the node
+	int size = nodeSize(level);
+	int col0 = x * size;
+	int row0 = y * size;
+	int col1 = std::min(col0 + size, subdivisions);
+	int row1 = std::min(row0 + size, subdivisions);
+
+	glm::vec2 cellSize = terrainSize / (float)std::max(subdivisions, 1);
+	low = glm::vec3(col0 * cellSize.x - terrainSize.x / 2.0f, heights.x, row0 * cellSize.y - terrainSize.y / 2.0f);
+	high = glm::vec3(col1 * cellSize.x - terrainSize.x / 2.0f, heights.y, row1 * cellSize.y - terrainSize.y / 2.0f);
+	return true;
+}
+
+
+TerrainLOD::TerrainLOD()
+	: patchReady(false)
+	, terrainSize(1.0f)
+	, camera(0.0f)
+	, triangles(0)
+{}
+
+
+void TerrainLOD::select(const TerrainLODTree& tree, const config& cfg, glm::vec3 cameraPos, float projectionScale,
+	const Frustum& viewFrustum)
+{
+	selection.clear();
+	triangles = 0;
+
+	terrainSize = glm::vec2(cfg.width, cfg.height);
+	glm::vec2 cellSize = terrainSize / (float)std::max(tree.subdivisions, 1);
+	camera = cameraPos;
+	frustum = viewFrustum;
+
+	// A level is good enough as long as its vertex spacing stays under
+	// lodError pixels on screen. The ranges have to reach past a whole node
+	// of the next level as well, so that neighbouring nodes never differ by
+	// more than one level and the morph can close every crack.
+	float spacing = std::max(cellSize.x, cellSize.y);
+	float pixelError = (float)std::max(cfg.lodError, 1);
+	ranges.resize(tree.levels);
+	for (int level = 0; level < tree.levels; level++) {
+		float screenRange = spacing * (float)(1 << level) * projectionScale / pixelError;
+		float nodeRange = 3.0f * spacing * (float)tree.nodeSize(level + 1);
+		ranges[level] = std::max(screenRange, nodeRange);
+	}
+	// The root is used at any distance
+	ranges[tree.levels - 1] = std::numeric_limits<float>::max();
+
+	selectNode(tree, tree.levels - 1, 0, 0);
+}
+
+
+bool TerrainLOD::inRange(glm::vec3 low, glm::vec3 high, float range) const
+{
+	// Distance from the camera to the closest point of the bounding box
+	glm::vec3 offset = camera - glm::clamp(camera, low, high);
+	return glm::dot(offset, offset) <= range * range;
+}
+
+
+bool TerrainLOD::selectNode(const TerrainLODTree& tree, int level, int x, int y)
+{
+	glm::vec3 low, high;
+	if (!tree.nodeBox(level, x, y, terrainSize, low, high) || !frustum.intersects(low, high)) {
+		// Past the grid border or off screen, nothing to draw
+		return true;
+	}
+	if (!inRange(low, high, ranges[level])) {
+		return false;
+	}
+
+	int size = tree.nodeSize(level);
+	Node node;
+	node.origin = glm::ivec2(x * size, y * size);
+	node.size = size;
+	node.level = level;
+	node.quadrants = 0;
+
+	if (level == 0 || !inRange(low, high, ranges[level - 1])) {
+		// Too far for any of the children
+		node.quadrants = AllQuadrants;
+	}
+	else {
+		// Children that are too far still get drawn at this level
+		for (int q = 0; q < 4; q++) {
+			if (!selectNode(tree, level - 1, x * 2 + (q & 1), y * 2 + (q >> 1))) {
+				node.quadrants |= 1 << q;
+			}
+		}
+	}
+
+	if (node.quadrants != 0) {
+		int quadrantTriangles = (TerrainLODTree::PatchSize / 2) * (TerrainLODTree::PatchSize / 2) * 2;
+		for (int q = 0; q < 4; q++) {
+			if (node.quadrants & (1 << q)) {
+				triangles += quadrantTriangles;
+			}
+		}
+		selection.push_back(node);
+	}
+	return true;
+}
+
+
+void TerrainLOD::createPatch()
+{
+	constexpr int PatchSize = TerrainLODTree::PatchSize;
+	constexpr int Half = PatchSize / 2;
+	int stride = PatchSize + 1;
+
+	// Quadrant after quadrant, so each one is a contiguous index range.
+	// Same winding as the full grid.
+	std::vector<unsigned int> indices;
+	indices.reserve(PatchSize * PatchSize * 6);
+	for (int q = 0; q < 4; q++) {
+		int col0 = (q & 1) * Half;
+		int row0 = (q >> 1) * Half;
+		for (int row = row0; row < row0 + Half; row++) {
+			for (int col = col0; col < col0 + Half; col++) {
+				unsigned int i0 = row * stride + col;
+				unsigned int i1 = i0 + 1;
+				unsigned int i2 = i0 + stride;
+				unsigned int i3 = i2 + 1;
+
+				indices.push_back(i0);
+				indices.push_back(i1);
+				indices.push_back(i2);
+
+				indices.push_back(i1);
+				indices.push_back(i3);
+				indices.push_back(i2);
+			}
+		}
+	}
+
+	// test.vert places the vertices from gl_VertexID
+	patch.setupAttributeless();
+	patch.setIndices(indices, (size_t)stride * stride);
+	patchReady = true;
+}
+
+
+void TerrainLOD::draw(GLuint program, GLenum mode)
+{
+	if (!patchReady) {
+		createPatch();
+	}
+
+	glUniform1i(glGetUniformLocation(program, "patchSize"), TerrainLODTree::PatchSize);
+	glUniform3f(glGetUniformLocation(program, "lodCamera"), camera.x, camera.y, camera.z);
+	GLint originLocation = glGetUniformLocation(program, "nodeOrigin");
+	GLint sizeLocation = glGetUniformLocation(program, "nodeSize");
+	GLint morphLocation = glGetUniformLocation(program, "nodeMorph");
+
+	GLsizei quadrantIndices = patch.getIndexCount() / 4;
+	int topLevel = (int)ranges.size() - 1;
+
+	for (const Node& node : selection) {
+		// Morph towards the next level over the last stretch of the range,
+		// the root has nothing to morph into
+		glm::vec2 morph(0.0f);
+		if (node.level < topLevel) {
+			float end = ranges[node.level];
+			float start = (node.level > 0) ? ranges[node.level - 1] : 0.0f;
+			start += (end - start) * MorphStart;
+			morph = glm::vec2(start, 1.0f / (end - start));
+		}
+
+		glUniform2f(originLocation, (float)node.origin.x, (float)node.origin.y);
+		glUniform1f(sizeLocation, (float)node.size);
+		glUniform2f(morphLocation, morph.x, morph.y);
+
+		if (node.quadrants == AllQuadrants) {
+			patch.drawElements(mode, 0, patch.getIndexCount());
+			continue;
+		}
+		for (int q = 0; q < 4; q++) {
+			if (node.quadrants & (1 << q)) {
+				patch.drawElements(mode, q * quadrantIndices, quadrantIndices);
+			}
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Chunked level of detail for the height texture (vertexFormat 3), after
+// Strugar's CDLOD.
+//
+// A quadtree covers the grid and every node is drawn with the same patch of
+// PatchSize x PatchSize quads, so each level up halves the vertex density.
+// Nodes are picked every frame by their distance to the camera. The distance
+// ranges of the levels follow from how many pixels one grid spacing covers
+// on screen, so the drawn triangle count depends on the view and not on the
+// grid resolution. test.vert morphs the vertices of each patch into the next
+// coarser level before the switch, which keeps neighbouring levels crack-free.
+//------------------------------------------------------------------------------
+
+#include "config.h"
+#include "Frustum.h"
+#include "Geometry.h"
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+
+// Height bounds of every quadtree node, built with the heights off the GL
+// thread. Level 0 holds the finest nodes, one patch quad per grid cell, which
+// double as the culling chunks of the full grid formats (TerrainChunks).
+struct TerrainLODTree {
+	static constexpr int PatchSize = 32; // quads per patch side, power of two
+
+	int subdivisions = 0; // grid cells per side
+	int levels = 0;
+	std::vector<std::vector<glm::vec2>> bounds; // per level, min and max height of each node, row by row
+
+	int nodesPerSide(int level) const { return 1 << (levels - 1 - level); }
+	int nodeSize(int level) const { return PatchSize << level; } // grid cells per side
+
+	// Nodes entirely past the grid border are empty, min > max
+	glm::vec2 nodeBounds(int level, int x, int y) const { return bounds[level][y * nodesPerSide(level) + x]; }
+
+	// World space box of a node on a terrain of terrainSize, cut off at the
+	// grid border. False for empty nodes.
+	bool nodeBox(int level, int x, int y, glm::vec2 terrainSize, glm::vec3& low, glm::vec3& high) const;
+};
+
+// Bounds for the (subdivisions+1)^2 heights, row by row
+std::shared_ptr<const TerrainLODTree> buildLODTree(int subdivisions, const std::vector<float>& heights, ThreadPool& workers);
+// Same from the level 0 bounds alone, lodTreeLeavesPerSide() squared of
+// them row by row, e.g. computed on the GPU
+std::shared_ptr<const TerrainLODTree> buildLODTree(int subdivisions, std::vector<glm::vec2> leafBounds);
+int lodTreeLeavesPerSide(int subdivisions);
+
+
+class TerrainLOD {
+
+public:
+	TerrainLOD();
+
+	// Picks the nodes to draw. cameraPos is in terrain space, projectionScale
+	// is the viewport height over 2 tan(fovy / 2), i.e. pixels per world unit
+	// at distance 1. Nodes outside the frustum are left out.
+	void select(const TerrainLODTree& tree, const config& cfg, glm::vec3 cameraPos, float projectionScale,
+		const Frustum& frustum = Frustum());
+
+	// Draws the selected nodes with the bound program, which reads the heights
+	// from its heightMap sampler
+	void draw(GLuint program, GLenum mode);
+
+	size_t getNodeCount() const { return selection.size(); }
+	size_t getTriangleCount() const { return triangles; }
+
+private:
+	// A node drawn in full, or only in the quadrants whose children are out
+	// of their own range
+	struct Node {
+		glm::ivec2 origin; // grid cell of the corner
+		int size;          // grid cells per side
+		int level;
+		int quadrants;     // bit per quadrant, row by row
+	};
+
+	GPU_Geometry patch;  // attributeless, indices quadrant by quadrant
+	bool patchReady;
+
+	std::vector<Node> selection;
+	std::vector<float> ranges;     // distance up to which each level is used
+	glm::vec2 terrainSize;
+	glm::vec3 camera;
+	Frustum frustum;
+	size_t triangles;
+
+	void createPatch();
+	// False when the node is out of its range and the parent has to cover it
+	bool selectNode(const TerrainLODTree& tree, int level, int x, int y);
+	bool inRange(glm::vec3 low, glm::vec3 high, float range) const;
+};
@@ -0,0 +1,137 @@
+#include "TerrainMesh.h"
+
+
+void gridIndices(ThreadPool& workers, int subdivisions, unsigned int* indices)
+{
+	workers.parallelFor(0, subdivisions, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			for (int col = 0; col < subdivisions; col++) {
+				int i0 = row * (subdivisions + 1) + col;
+				int i1 = row * (subdivisions + 1) + (col + 1);
+				int i2 = (row + 1) * (subdivisions + 1) + col;
+				int i3 = (row + 1) * (subdivisions + 1) + (col + 1);
+
+				unsigned int* quad = &indices[((size_t)row * subdivisions + col) * 6];
+
+				// Two triangles per quad
+				// Triangle 1
+				quad[0] = i0;
+				quad[1] = i1;
+				quad[2] = i2;
+
+				// Triangle 2
+				quad[3] = i1;
+				quad[4] = i3;
+				quad[5] = i2;
+			}
+		}
+	});
+}
+
+
+void scatterNormals(
+	const std::vector<unsigned int>& indices,
+	std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& verts)
+{
+	// Reset normals
+	for (auto& v : normals) {
+		v.x = 0.0f;
+		v.y = 0.0f;
+		v.z = 0.0f;
+	}
+
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		unsigned int i0 = indices[i];
+		unsigned int i1 = indices[i + 1];
+		unsigned int i2 = indices[i + 2];
+
+		const glm::vec3& v0 = verts[i0];
+		const glm::vec3& v1 = verts[i1];
+		const glm::vec3& v2 = verts[i2];
+
+		// Two edges of the triangle
+		float ux = v1.x - v0.x;
+		float uy = v1.y - v0.y;
+		float uz = v1.z - v0.z;
+
+		float vx = v2.x - v0.x;
+		float vy = v2.y - v0.y;
+		float vz = v2.z - v0.z;
+
+		// Cross product to get face normal
+		float nx = (uy * vz) - (uz * vy);
+		float ny = (uz * vx) - (ux * vz);
+		float nz = (ux * vy) - (uy * vx);
+
+		// Accumulate
+		normals[i0].x += nx;  normals[i0].y += ny;  normals[i0].z += nz;
+		normals[i1].x += nx;  normals[i1].y += ny;  normals[i1].z += nz;
+		normals[i2].x += nx;  normals[i2].y += ny;  normals[i2].z += nz;
+	}
+
+	 //Normalize the accumulated normals
+	for (auto& v : normals) {
+		float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+		if (length > 1e-6f) {
+			v.x /= length;
+			v.y /= length;
+			v.z /= length;
+		}
+	}
+}
+
+
+void centralDifferenceNormals(ThreadPool& workers, int subdivisions, float spacingX, float spacingZ,
+	const float* heights, glm::vec3* normals)
+{
+	int stride = subdivisions + 1;
+	constexpr int Chunk = 256;
+
+	workers.parallelFor(0, subdivisions + 1, [&](int rowBegin, int rowEnd) {
+		float nx[Chunk];
+		float nz[Chunk];
+		float scale[Chunk];
+
+		for (int row = rowBegin; row < rowEnd; row++) {
+			int rowUp = std::max(row - 1, 0);
+			int rowDown = std::min(row + 1, subdivisions);
+			const float* up = heights + rowUp * stride;
+			const float* down = heights + rowDown * stride;
+			const float* center = heights + row * stride;
+
+			float inverseX = 1.0f / (2.0f * spacingX);
+			float inverseZ = 1.0f / ((rowDown - rowUp) * spacingZ);
+
+			for (int begin = 0; begin < stride; begin += Chunk) {
+				int count = std::min(Chunk, stride - begin);
+
+				for (int k = 0; k < count; k++) {
+					int col = begin + k;
+					// Clamped neighbours only differ on the two border
+					// columns, which get fixed up below
+					float left = center[col > 0 ? col - 1 : col];
+					float right = center[col < subdivisions ? col + 1 : col];
+					nx[k] = (right - left) * inverseX;
+					nz[k] = (down[col] - up[col]) * inverseZ;
+				}
+				if (begin == 0) {
+					nx[0] *= 2.0f;
+				}
+				if (begin + count == stride && subdivisions > 0) {
+					nx[count - 1] *= 2.0f;
+				}
+
+				// normalize(dx, -1, dz), the argument is at least 1
+				for (int k = 0; k < count; k++) {
+					scale[k] = 1.0f / std::sqrt(nx[k] * nx[k] + 1.0f + nz[k] * nz[k]);
+				}
+
+				glm::vec3* out = normals + row * stride + begin;
+				for (int k = 0; k < count; k++) {
+					out[k] = glm::vec3(nx[k] * scale[k], -scale[k], nz[k] * scale[k]);
+				}
+			}
+		}
+	});
+}
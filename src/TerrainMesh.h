@@ -0,0 +1,131 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Index buffer and normals of the (subdivisions+1)^2 terrain grid, built on
+// the CPU from positions or heights. Nothing in here touches GL, the headless
+// tools share it with mountain.
+//------------------------------------------------------------------------------
+
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Two triangles per quad, subdivisions^2 * 6 indices, row by row. Vertex
+// (row, col) is index row * (subdivisions+1) + col.
+void gridIndices(ThreadPool& workers, int subdivisions, unsigned int* indices);
+
+// Reference normals: accumulates the face normals of every triangle into its
+// vertices, then normalizes. Serial, normals is resized by the caller.
+void scatterNormals(
+	const std::vector<unsigned int>& indices,
+	std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& verts);
+
+// Smooth normals of the (subdivisions+1)^2 grid, position(i) giving the
+// position of vertex i. Every vertex touches up to six faces of the quad
+// rows above and below it. Each band keeps the face normals of just those
+// two quad rows, and adding them up in index buffer order keeps the sums
+// bit-identical to scatterNormals(). normals is
+// only written, so it may point into mapped GL memory.
+template <typename Position>
+void gridNormals(ThreadPool& workers, int subdivisions, glm::vec3* normals, const Position& position)
+{
+	int stride = subdivisions + 1;
+
+	auto faceNormal = [&](int i0, int i1, int i2) {
+		glm::vec3 v0 = position(i0);
+		glm::vec3 v1 = position(i1);
+		glm::vec3 v2 = position(i2);
+
+		float ux = v1.x - v0.x;
+		float uy = v1.y - v0.y;
+		float uz = v1.z - v0.z;
+
+		float vx = v2.x - v0.x;
+		float vy = v2.y - v0.y;
+		float vz = v2.z - v0.z;
+
+		return glm::vec3(
+			(uy * vz) - (uz * vy),
+			(uz * vx) - (ux * vz),
+			(ux * vy) - (uy * vx)
+		);
+	};
+
+	// Both triangles of every quad in a row, in the order elevate() emits
+	// them into the index buffer
+	auto quadRowFaces = [&](int quadRow, std::vector<glm::vec3>& faces) {
+		if (quadRow < 0 || quadRow >= subdivisions) {
+			return;
+		}
+		for (int col = 0; col < subdivisions; col++) {
+			int i0 = quadRow * stride + col;
+			int i1 = i0 + 1;
+			int i2 = i0 + stride;
+			int i3 = i2 + 1;
+
+			faces[col * 2 + 0] = faceNormal(i0, i1, i2);
+			faces[col * 2 + 1] = faceNormal(i1, i3, i2);
+		}
+	};
+
+	workers.parallelFor(0, subdivisions + 1, [&](int rowBegin, int rowEnd) {
+		std::vector<glm::vec3> above(subdivisions * 2);
+		std::vector<glm::vec3> below(subdivisions * 2);
+		quadRowFaces(rowBegin - 1, above);
+
+		for (int row = rowBegin; row < rowEnd; row++) {
+			quadRowFaces(row, below);
+
+			for (int col = 0; col <= subdivisions; col++) {
+				glm::vec3 n(0.0f, 0.0f, 0.0f);
+				auto add = [&](int quadRow, int quadCol, int triangle) {
+					if (quadRow < 0 || quadRow >= subdivisions || quadCol < 0 || quadCol >= subdivisions) {
+						return;
+					}
+					const std::vector<glm::vec3>& faces = (quadRow < row) ? above : below;
+					const glm::vec3& f = faces[quadCol * 2 + triangle];
+					n.x += f.x;  n.y += f.y;  n.z += f.z;
+				};
+
+				add(row - 1, col - 1, 1);
+				add(row - 1, col, 0);
+				add(row - 1, col, 1);
+				add(row, col - 1, 0);
+				add(row, col - 1, 1);
+				add(row, col, 0);
+
+				float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+				if (length > 1e-6f) {
+					n.x /= length;
+					n.y /= length;
+					n.z /= length;
+				}
+				normals[row * stride + col] = n;
+			}
+
+			std::swap(above, below);
+		}
+	});
+}
+
+
+// Normals from central differences of the heights, one-sided on the
+// border. Oriented like the face normals above (the grid winds so they
+// point towards -y). Interior columns are a straight loop over contiguous
+// heights that vectorizes, and rows split across threads without sharing.
+void centralDifferenceNormals(ThreadPool& workers, int subdivisions, float spacingX, float spacingZ,
+	const float* heights, glm::vec3* normals);
+
+// Unit normal from the world space slope of the heights, dh/dx and dh/dz,
+// oriented like the face normals
+inline glm::vec3 slopeNormal(float slopeX, float slopeZ)
+{
+	float scale = 1.0f / std::sqrt(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+	return glm::vec3(slopeX * scale, -scale, slopeZ * scale);
+}
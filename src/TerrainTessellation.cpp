@@ -0,0 +1,36 @@
+#include "TerrainTessellation.h"
+#include "DrawStats.h"
+#include "GLTessellation.h"
+
+#include <algorithm>
+
+
+TerrainTessellation::TerrainTessellation()
+	: ready(false)
+	, patchesPerSide(0)
+{}
+
+
+void TerrainTessellation::draw(GLuint program, const config& cfg, glm::vec3 cameraPos, float projectionScale)
+{
+	if (!ready) {
+		patches.setupAttributeless();
+		ready = true;
+	}
+
+	// Patches small enough that the highest level reaches single grid
+	// cells, but enough of them that culling them is worth it
+	int maxLevel = GLTessellation::maxLevel();
+	patchesPerSide = std::max((cfg.subdivisions + maxLevel - 1) / maxLevel, 8);
+
+	glUniform1i(glGetUniformLocation(program, "patchesPerSide"), patchesPerSide);
+	glUniform3f(glGetUniformLocation(program, "lodCamera"), cameraPos.x, cameraPos.y, cameraPos.z);
+	glUniform1f(glGetUniformLocation(program, "projectionScale"), projectionScale);
+	glUniform1f(glGetUniformLocation(program, "tessPixels"), (float)std::max(cfg.lodError, 1));
+	glUniform1f(glGetUniformLocation(program, "maxTessLevel"), (float)maxLevel);
+
+	patches.bind();
+	GLTessellation::setPatchVertices(4);
+	glDrawArrays(GL_PATCHES, 0, 4 * getPatchCount());
+	DrawStats::count(GL_PATCHES, 4 * getPatchCount());
+}
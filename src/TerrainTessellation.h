@@ -0,0 +1,33 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Hardware tessellation of the height texture (vertexFormat 4), GL 4.0 and up.
+//
+// The grid is covered by a coarse grid of quad patches, a few thousand at
+// most, that go to the GPU as four attributeless vertices each. The shaders
+// in terrain.tesc / terrain.tese subdivide every patch by how large its edges
+// are on screen and displace the new vertices from the height texture.
+//------------------------------------------------------------------------------
+
+#include "config.h"
+#include "Geometry.h"
+
+#include <glm/glm.hpp>
+
+
+class TerrainTessellation {
+
+public:
+	TerrainTessellation();
+
+	// Draws the grid of cfg with the bound tessellation program. cameraPos
+	// and projectionScale as in TerrainLOD::select().
+	void draw(GLuint program, const config& cfg, glm::vec3 cameraPos, float projectionScale);
+
+	int getPatchCount() const { return patchesPerSide * patchesPerSide; }
+
+private:
+	GPU_Geometry patches; // no attributes, just the VAO core profiles need
+	bool ready;
+	int patchesPerSide;
+};
@@ -1,4 +1,5 @@
 #include "Texture.h"
+#include "Profiler.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
@@ -7,10 +8,10 @@
 Texture::Texture(std::string path, GLint interpolation)
 	: textureID(), path(path), interpolation(interpolation)
 {
-	int numComponents;
+	PROFILE_ZONE("texture load");
 	stbi_set_flip_vertically_on_load(true);
 	const char* pathData = path.c_str();
-	unsigned char* data = stbi_load(pathData, &width, &height, &numComponents, 0);
+	unsigned char* data = stbi_load(pathData, &width, &height, &components, 0);
 	std::cout << "Loaded texture data from file: " << pathData << std::endl;
 	if (data != nullptr)
 	{
@@ -20,7 +21,7 @@ Texture::Texture(std::string path, GLint interpolation)
 
 		//Set number of components by format of the texture
 		GLuint format = GL_RGB;
-		switch (numComponents)
+		switch (components)
 		{
 		case 4:
 			format = GL_RGBA;
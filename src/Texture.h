@@ -27,6 +27,8 @@ public:
 	// Although uint (i.e. uvec2) might make more sense here, went with int (i.e. ivec2) under
 	// the assumption that most students will want to work with ints, not uints, in main.cpp
 	glm::ivec2 getDimensions() const { return glm::uvec2(width, height); }
+	// GPU memory of the image, one byte per component and texel
+	size_t bytes() const { return (size_t)width * height * components; }
 
 	void bind() { glBindTexture(GL_TEXTURE_2D, textureID); }
 	void unbind() { glBindTexture(GL_TEXTURE_2D, textureID); }
@@ -41,6 +43,7 @@ private:
 	// that most students will want to work with ints, not uints, in main.cpp
 	int width;
 	int height;
+	int components;
 
 
 
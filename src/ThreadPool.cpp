@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <utility>
+
+
+ThreadPool::ThreadPool(unsigned threads)
+	: stopping(false)
+{
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// The calling thread is the first "worker"
+	for (unsigned i = 1; i < threads; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+
+void ThreadPool::parallelFor(int first, int last, const std::function<void(int, int)>& fn, int minBand) {
+	int count = last - first;
+	if (count <= 0) {
+		return;
+	}
+
+	// A few bands per thread evens out rows that are cheaper than others
+	int bands = std::min(count / std::max(minBand, 1), (int)size() * 4);
+	if (workers.empty() || bands <= 1) {
+		fn(first, last);
+		return;
+	}
+
+	auto bandBegin = [&](int band) {
+		return first + (int)((long long)count * band / bands);
+	};
+
+	// The remaining counter is only touched under doneMutex so that this
+	// frame can't be unwound while a worker is still signalling it
+	int remaining = bands - 1;
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (int band = 1; band < bands; band++) {
+			int begin = bandBegin(band);
+			int end = bandBegin(band + 1);
+			tasks.emplace_back([&, begin, end]() {
+				fn(begin, end);
+
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				if (--remaining == 0) {
+					doneCondition.notify_all();
+				}
+			});
+		}
+	}
+	queueCondition.notify_all();
+
+	// Do the first band ourselves, then help with whatever is still queued
+	fn(bandBegin(0), bandBegin(1));
+	while (runPendingTask()) {}
+
+	std::unique_lock<std::mutex> doneLock(doneMutex);
+	doneCondition.wait(doneLock, [&]() { return remaining == 0; });
+}
+
+
+void ThreadPool::submit(std::function<void()> fn) {
+	if (workers.empty()) {
+		fn();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		tasks.emplace_back(std::move(fn));
+	}
+	queueCondition.notify_one();
+}
+
+
+void ThreadPool::workerLoop() {
+	PROFILE_THREAD_NAME("pool worker");
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) {
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+bool ThreadPool::runPendingTask() {
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (tasks.empty()) {
+			return false;
+		}
+		task = std::move(tasks.front());
+		tasks.pop_front();
+	}
+	task();
+	return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Small fixed-size pool of worker threads used to split terrain generation
+// into row bands, or to run independent jobs in the background.
+//
+// The calling thread always takes part in the work, so a pool created with a
+// single thread has no workers and runs everything inline.
+class ThreadPool {
+
+public:
+	// threads == 0 picks std::thread::hardware_concurrency()
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	// Worker threads can't be copied or moved
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of threads that take part in parallelFor, including the caller
+	unsigned size() const { return (unsigned)workers.size() + 1; }
+
+	// Splits [first, last) into contiguous bands of at least minBand items,
+	// calls fn(bandBegin, bandEnd) for each of them and blocks until all the
+	// bands are done. Bands never overlap, so fn can write to disjoint ranges
+	// of a shared output without synchronization.
+	void parallelFor(int first, int last, const std::function<void(int, int)>& fn, int minBand = 1);
+
+	// Queues fn for a worker thread and returns right away, jobs start in
+	// the order they were submitted. A pool without workers runs fn inline.
+	// Jobs still queued when the pool goes away run before it is destroyed.
+	void submit(std::function<void()> fn);
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool stopping;
+
+	void workerLoop();
+	bool runPendingTask();
+};
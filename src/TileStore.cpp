@@ -0,0 +1,343 @@
+#include "TileStore.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+	const char Magic[8] = { 'M', 'T', 'N', 'T', 'I', 'L', 'E', 'S' };
+
+	uint64_t alignUp(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+}
+
+
+TileStore::TileStore()
+	: data(nullptr)
+	, size(0)
+#ifdef _WIN32
+	, file(INVALID_HANDLE_VALUE)
+	, mapping(nullptr)
+#endif
+{}
+
+
+TileStore::~TileStore()
+{
+	close();
+}
+
+
+TileStore::Key TileStore::makeKey(const config& cfg)
+{
+	// Zeroed first so the hash in pathFor() never sees stray bytes
+	Key key;
+	std::memset(&key, 0, sizeof(key));
+	key.seed = cfg.seed;
+	key.octaves = cfg.octaves;
+	key.frequency = cfg.frequency;
+	key.lacunarity = cfg.lacunarity;
+	key.gain = cfg.gain;
+	key.ridgeOffset = cfg.ridgeOffset;
+	key.simd = cfg.simd;
+	key.width = cfg.width;
+	key.height = cfg.height;
+	key.subdivisions = cfg.subdivisions;
+	key.world = cfg.world;
+	return key;
+}
+
+
+std::string TileStore::pathFor(const config& cfg)
+{
+	// FNV-1a over the key
+	Key key = makeKey(cfg);
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(key); i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.tiles", (unsigned long long)hash);
+	return std::string("tilestore/") + name;
+}
+
+
+int TileStore::resolution(const config& cfg)
+{
+	// TileWorld makes at least one quad per tile
+	return cfg.world ? std::max(cfg.subdivisions, 1) + 3 : cfg.subdivisions + 1;
+}
+
+
+bool TileStore::open(const std::string& path, const config& cfg)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(FileHeader)) {
+		CloseHandle(fileHandle);
+		return false;
+	}
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* view = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!view) {
+		if (mappingHandle) {
+			CloseHandle(mappingHandle);
+		}
+		CloseHandle(fileHandle);
+		return false;
+	}
+	file = fileHandle;
+	mapping = mappingHandle;
+	data = static_cast<const unsigned char*>(view);
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(FileHeader)) {
+		::close(fd);
+		return false;
+	}
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file alive on its own
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+	data = static_cast<const unsigned char*>(view);
+	size = (size_t)info.st_size;
+#endif
+
+	if (!validate(cfg)) {
+		std::cerr << "Ignoring tile store " << path << ": damaged or made with other settings\n";
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+bool TileStore::validate(const config& cfg) const
+{
+	const FileHeader& head = header();
+	if (std::memcmp(head.magic, Magic, sizeof(Magic)) != 0
+		|| head.version != Version
+		|| head.headerBytes != sizeof(FileHeader)) {
+		return false;
+	}
+
+	Key key = makeKey(cfg);
+	if (std::memcmp(&head.key, &key, sizeof(Key)) != 0
+		|| head.resolution != (uint32_t)resolution(cfg)) {
+		return false;
+	}
+
+	// Only the index is checked, the tile data is paged in when it is used
+	if (head.tileCount > (size - sizeof(FileHeader)) / sizeof(IndexEntry)) {
+		return false;
+	}
+	uint64_t indexEnd = sizeof(FileHeader) + (uint64_t)head.tileCount * sizeof(IndexEntry);
+	uint64_t heightBytes = (uint64_t)head.resolution * head.resolution * sizeof(float);
+	uint64_t normalBytes = (uint64_t)head.resolution * head.resolution * sizeof(glm::vec3);
+	// Written without sums of file offsets, they could wrap around
+	auto fits = [&](uint64_t offset, uint64_t bytes) {
+		return offset >= indexEnd && offset % alignof(float) == 0 && offset <= size && bytes <= size - offset;
+	};
+	for (uint32_t i = 0; i < head.tileCount; i++) {
+		const IndexEntry& entry = index()[i];
+		if (!fits(entry.heightsOffset, heightBytes)
+			|| (entry.normalsOffset != 0 && !fits(entry.normalsOffset, normalBytes))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void TileStore::close()
+{
+	if (!data) {
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+	CloseHandle((HANDLE)file);
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	munmap(const_cast<unsigned char*>(data), size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+
+bool TileStore::find(int x, int z, TileData& out) const
+{
+	if (!data) {
+		return false;
+	}
+
+	// Linear scan, a store holds a few hundred tiles at most and the index
+	// is contiguous
+	const IndexEntry* entries = index();
+	for (uint32_t i = 0; i < header().tileCount; i++) {
+		const IndexEntry& entry = entries[i];
+		if (entry.x == x && entry.z == z) {
+			out.x = x;
+			out.z = z;
+			out.heights = reinterpret_cast<const float*>(data + entry.heightsOffset);
+			out.normals = entry.normalsOffset ? reinterpret_cast<const glm::vec3*>(data + entry.normalsOffset) : nullptr;
+			out.bounds = glm::vec2(entry.minHeight, entry.maxHeight);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+size_t TileStore::tileCount() const
+{
+	return data ? header().tileCount : 0;
+}
+
+
+int TileStore::normalMode() const
+{
+	return data ? header().normalMode : -1;
+}
+
+
+bool TileStore::save(const std::string& path, const config& cfg, const std::vector<TileData>& tiles)
+{
+	// Stored tiles that aren't replaced stay, as long as they were made
+	// with the same settings. Their normals only while the normalMode
+	// matches.
+	std::vector<TileData> all = tiles;
+	if (data && validate(cfg)) {
+		const IndexEntry* entries = index();
+		for (uint32_t i = 0; i < header().tileCount; i++) {
+			auto replaced = std::find_if(tiles.begin(), tiles.end(), [&](const TileData& tile) {
+				return tile.x == entries[i].x && tile.z == entries[i].z;
+			});
+			if (replaced == tiles.end()) {
+				TileData stored;
+				find(entries[i].x, entries[i].z, stored);
+				if (header().normalMode != cfg.normalMode) {
+					stored.normals = nullptr;
+				}
+				all.push_back(stored);
+			}
+		}
+	}
+
+	uint64_t side = (uint64_t)resolution(cfg);
+	uint64_t heightBytes = side * side * sizeof(float);
+	uint64_t normalBytes = side * side * sizeof(glm::vec3);
+
+	FileHeader head;
+	std::memset(&head, 0, sizeof(head));
+	std::memcpy(head.magic, Magic, sizeof(Magic));
+	head.version = Version;
+	head.headerBytes = sizeof(FileHeader);
+	head.resolution = (uint32_t)side;
+	head.tileCount = (uint32_t)all.size();
+	head.normalMode = cfg.normalMode;
+	head.key = makeKey(cfg);
+
+	// Lay out the index before writing anything
+	std::vector<IndexEntry> entries(all.size());
+	uint64_t offset = alignUp(sizeof(FileHeader) + entries.size() * sizeof(IndexEntry), Alignment);
+	for (size_t i = 0; i < all.size(); i++) {
+		IndexEntry& entry = entries[i];
+		entry.x = all[i].x;
+		entry.z = all[i].z;
+		entry.minHeight = all[i].bounds.x;
+		entry.maxHeight = all[i].bounds.y;
+		entry.heightsOffset = offset;
+		offset = alignUp(offset + heightBytes, Alignment);
+		entry.normalsOffset = 0;
+		if (all[i].normals) {
+			entry.normalsOffset = offset;
+			offset = alignUp(offset + normalBytes, Alignment);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::path target(path);
+	if (target.has_parent_path()) {
+		std::filesystem::create_directories(target.parent_path(), error);
+	}
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+			std::cerr << "Error: Could not write tile store " << temporary << std::endl;
+			return false;
+		}
+
+		out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+		out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(IndexEntry));
+
+		const char zeros[Alignment] = {};
+		auto pad = [&](uint64_t to) {
+			uint64_t at = (uint64_t)out.tellp();
+			out.write(zeros, (std::streamsize)(to - at));
+		};
+		for (size_t i = 0; i < all.size(); i++) {
+			pad(entries[i].heightsOffset);
+			out.write(reinterpret_cast<const char*>(all[i].heights), (std::streamsize)heightBytes);
+			if (all[i].normals) {
+				pad(entries[i].normalsOffset);
+				out.write(reinterpret_cast<const char*>(all[i].normals), (std::streamsize)normalBytes);
+			}
+		}
+		if (!out) {
+			std::cerr << "Error: Could not write tile store " << temporary << std::endl;
+			out.close();
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+
+	// Tiles may point into the old mapping until here. Windows can't
+	// replace a mapped file.
+	close();
+	std::filesystem::rename(temporary, path, error);
+	if (error) {
+		std::cerr << "Error: Could not replace tile store " << path << ": " << error.message() << std::endl;
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return open(path, cfg);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// On-disk store of generated heightfield tiles, so terrain that was made once
+// is loaded again instead of regenerated.
+//
+// One file holds the tiles of one set of noise and grid settings:
+//
+//   FileHeader   magic, version and the settings the tiles were made with
+//   IndexEntry   tileCount entries, tile position, height bounds, offsets
+//   tile data    resolution^2 float heights per tile, row by row,
+//                optionally followed by as many glm::vec3 normals
+//
+// Everything is little endian and laid out like the structs below, so a
+// TileStore maps the file and hands out pointers into it. Pages are only read
+// when a tile is touched. The single mountain is tile (0, 0) of a file made
+// with world 0, TileWorld tiles are keyed by their tile position.
+//------------------------------------------------------------------------------
+
+#include "config.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// One tile of a store. The pointers belong to whoever made it, for tiles
+// found in a TileStore they point into the mapped file.
+struct TileData {
+	int x = 0;
+	int z = 0;
+	const float* heights = nullptr;       // TileStore::resolution()^2
+	const glm::vec3* normals = nullptr;   // same count, or null
+	glm::vec2 bounds = glm::vec2(0.0f);   // minimum and maximum height
+};
+
+
+class TileStore {
+
+public:
+	TileStore();
+	~TileStore();
+
+	// Owns a mapping, can't be copied
+	TileStore(const TileStore&) = delete;
+	TileStore& operator=(const TileStore&) = delete;
+
+	// File the tiles of cfg go to, named after the settings they depend on
+	static std::string pathFor(const config& cfg);
+	// Heights per tile side, subdivisions + 1. World tiles add the one
+	// sample apron around them that sampleTileRow() makes.
+	static int resolution(const config& cfg);
+
+	// Maps path read-only. False, and nothing mapped, when the file is
+	// missing, damaged, of another version or made with other settings.
+	bool open(const std::string& path, const config& cfg);
+	void close();
+	bool isOpen() const { return data != nullptr; }
+
+	// Pointers into the mapping, valid until the store is closed
+	bool find(int x, int z, TileData& out) const;
+	size_t tileCount() const;
+	// config normalMode the stored normals were made with
+	int normalMode() const;
+
+	// Writes tiles, and the tiles of the open store that aren't replaced by
+	// one of them, to path and maps the result. tiles may point into this
+	// store. The file is written next to path first, readers never see a
+	// half written store.
+	bool save(const std::string& path, const config& cfg, const std::vector<TileData>& tiles);
+
+	static constexpr uint32_t Version = 2;
+
+private:
+	// Settings the heights depend on
+	struct Key {
+		int32_t seed;
+		float octaves;
+		float frequency;
+		float lacunarity;
+		float gain;
+		float ridgeOffset;
+		int32_t simd;
+		int32_t width;
+		int32_t height;
+		int32_t subdivisions;
+		int32_t world;
+	};
+
+	struct FileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t headerBytes;    // sizeof(FileHeader), catches layout changes
+		uint32_t resolution;     // vertices per tile side
+		uint32_t tileCount;
+		int32_t normalMode;
+		uint32_t padding;
+		Key key;
+		uint32_t padding2;
+	};
+
+	struct IndexEntry {
+		int32_t x;
+		int32_t z;
+		float minHeight;
+		float maxHeight;
+		uint64_t heightsOffset;  // from the start of the file
+		uint64_t normalsOffset;  // 0 when the tile has no normals
+	};
+
+	// Tile data starts on cache line boundaries
+	static constexpr uint64_t Alignment = 64;
+
+	static Key makeKey(const config& cfg);
+
+	const unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#endif
+
+	const FileHeader& header() const { return *reinterpret_cast<const FileHeader*>(data); }
+	const IndexEntry* index() const { return reinterpret_cast<const IndexEntry*>(data + sizeof(FileHeader)); }
+	bool validate(const config& cfg) const;
+};
@@ -0,0 +1,418 @@
+#include "TileWorld.h"
+#include "DrawStats.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <utility>
+
+
+namespace {
+	// Whether tiles made for one config are still valid for the other
+	bool sameTiles(const config& a, const config& b)
+	{
+		return a.seed == b.seed
+			&& a.octaves == b.octaves
+			&& a.frequency == b.frequency
+			&& a.lacunarity == b.lacunarity
+			&& a.gain == b.gain
+			&& a.ridgeOffset == b.ridgeOffset
+			&& a.simd == b.simd
+			&& a.width == b.width
+			&& a.height == b.height
+			&& a.subdivisions == b.subdivisions
+			&& a.tileStore == b.tileStore;
+	}
+
+	// Height textures carry the apron from sampleTileRow(), so the normals
+	// on the tile border come from the neighbouring heights
+	int textureSize(int cells)
+	{
+		return cells + 3;
+	}
+
+	size_t textureBytes(int cells)
+	{
+		return (size_t)textureSize(cells) * textureSize(cells) * sizeof(float);
+	}
+
+	// Heights of tile (x, z) with the apron, bounds of the drawn ones
+	// without it. False when cancelled is set halfway.
+	bool sampleTile(const HeightfieldSampler& sampler, int x, int z, int cells, float* heights, glm::vec2& bounds,
+		const std::atomic<bool>* cancelled = nullptr)
+	{
+		int stride = textureSize(cells);
+		bounds = glm::vec2(std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest());
+		for (int row = -1; row <= cells + 1; row++) {
+			if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+				return false;
+			}
+			float* rowHeights = heights + (size_t)(row + 1) * stride;
+			sampler.sampleTileRow(x, z, cells, row, rowHeights);
+			if (row < 0 || row > cells) {
+				continue;
+			}
+			for (int col = 1; col <= cells + 1; col++) {
+				bounds.x = std::min(bounds.x, rowHeights[col]);
+				bounds.y = std::max(bounds.y, rowHeights[col]);
+			}
+		}
+		return true;
+	}
+}
+
+
+TileWorld::TileWorld()
+	: configured(false)
+	, frame(0)
+	, memoryBytes(0)
+	, pendingCount(0)
+	, placeholdersDrawn(0)
+	, gridCells(0)
+	, placeholderCells(0)
+	, unsavedBytes(0)
+{}
+
+
+TileWorld::~TileWorld()
+{
+	saveTiles();
+
+	// Queued jobs return as soon as they start, running ones after their
+	// current row
+	for (auto& entry : tiles) {
+		cancelJob(entry.second);
+	}
+}
+
+
+void TileWorld::reset(const config& cfg)
+{
+	// Still with the old settings
+	saveTiles();
+
+	for (auto& entry : tiles) {
+		cancelJob(entry.second);
+	}
+	tiles.clear();
+	lru.clear();
+	wanted.clear();
+	memoryBytes = 0;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.clear();
+	}
+
+	layout = cfg;
+	configured = true;
+	sampler = std::make_shared<HeightfieldSampler>(cfg);
+	gridCells = std::max(cfg.subdivisions, 1);
+	placeholderCells = std::min(PlaceholderCells, gridCells);
+	setupGrid(grid, gridCells);
+	setupGrid(placeholderGrid, placeholderCells);
+
+	if (cfg.tileStore) {
+		store.open(TileStore::pathFor(cfg), cfg);
+	}
+	else {
+		store.close();
+	}
+
+	// At least one worker, the render thread never generates full tiles
+	if (!pool) {
+		unsigned threads = (cfg.threads > 0) ? (unsigned)cfg.threads : std::thread::hardware_concurrency();
+		pool = std::make_unique<ThreadPool>(std::max(threads, 2u));
+	}
+	std::cout << "Tiled world: " << cfg.width << " x " << cfg.height << " tiles of "
+		<< gridCells << " x " << gridCells << " quads, " << store.tileCount() << " stored\n";
+}
+
+
+void TileWorld::saveTiles()
+{
+	PROFILE_ZONE("tile store save");
+	if (configured && layout.tileStore && !unsaved.empty()) {
+		std::vector<TileData> data;
+		data.reserve(unsaved.size());
+		for (const TileResult& result : unsaved) {
+			TileData tile;
+			tile.x = result.key.x;
+			tile.z = result.key.z;
+			tile.heights = result.heights.data();
+			tile.bounds = result.bounds;
+			data.push_back(tile);
+		}
+		if (store.save(TileStore::pathFor(layout), layout, data)) {
+			std::cout << "Stored " << data.size() << " new tiles, " << store.tileCount() << " in total\n";
+		}
+	}
+	unsaved.clear();
+	unsavedBytes = 0;
+}
+
+
+void TileWorld::setupGrid(GPU_Geometry& geom, int cells)
+{
+	// Same triangles as the single mountain's grid, test.vert places the
+	// vertices from gl_VertexID
+	int stride = cells + 1;
+	std::vector<unsigned int> indices;
+	indices.reserve((size_t)cells * cells * 6);
+	for (int row = 0; row < cells; row++) {
+		for (int col = 0; col < cells; col++) {
+			unsigned int i0 = row * stride + col;
+			unsigned int i1 = i0 + 1;
+			unsigned int i2 = i0 + stride;
+			unsigned int i3 = i2 + 1;
+
+			indices.push_back(i0);
+			indices.push_back(i1);
+			indices.push_back(i2);
+
+			indices.push_back(i1);
+			indices.push_back(i3);
+			indices.push_back(i2);
+		}
+	}
+
+	geom.setupAttributeless();
+	geom.setIndices(indices, (size_t)stride * stride);
+}
+
+
+void TileWorld::update(const config& cfg, glm::vec3 cameraPos)
+{
+	PROFILE_ZONE("tile update");
+	if (!configured || !sameTiles(layout, cfg)) {
+		reset(cfg);
+	}
+	frame++;
+
+	// Square of tiles around the one under the camera, nearest first. Tile
+	// (x, z) is centred on (x * width, z * height).
+	glm::vec2 tileSize((float)layout.width, (float)layout.height);
+	glm::vec2 camera(cameraPos.x, cameraPos.z);
+	int centreX = (int)std::floor(camera.x / tileSize.x + 0.5f);
+	int centreZ = (int)std::floor(camera.y / tileSize.y + 0.5f);
+	int radius = std::max(cfg.tileRadius, 0);
+
+	wanted.clear();
+	for (int z = centreZ - radius; z <= centreZ + radius; z++) {
+		for (int x = centreX - radius; x <= centreX + radius; x++) {
+			wanted.push_back(TileKey{ x, z });
+		}
+	}
+	auto distance = [&](TileKey key) {
+		glm::vec2 offset = glm::vec2((float)key.x, (float)key.z) * tileSize - camera;
+		return glm::dot(offset, offset);
+	};
+	std::sort(wanted.begin(), wanted.end(), [&](TileKey a, TileKey b) {
+		return distance(a) < distance(b);
+	});
+
+	for (TileKey key : wanted) {
+		auto it = tiles.find(key);
+		Tile& tile = (it != tiles.end()) ? it->second : createTile(key);
+		tile.lastUsed = frame;
+		lru.splice(lru.begin(), lru, tile.lru);
+		if (!tile.texture && !tile.cancelled && !tile.stored) {
+			startJob(key, tile);
+		}
+	}
+
+	// Tiles the camera left behind aren't worth finishing
+	for (auto& entry : tiles) {
+		if (entry.second.lastUsed != frame) {
+			cancelJob(entry.second);
+		}
+	}
+
+	size_t budget = (size_t)std::max(cfg.tileCacheMB, 0) * 1024 * 1024;
+	uploadFinished(budget);
+
+	// Least recently wanted first, never the ones around the camera
+	while (memoryBytes > budget && !lru.empty() && tiles.at(lru.back()).lastUsed != frame) {
+		evict(lru.back());
+	}
+}
+
+
+TileWorld::Tile& TileWorld::createTile(TileKey key)
+{
+	Tile& tile = tiles[key];
+	lru.push_front(key);
+	tile.lru = lru.begin();
+
+	// Small enough to make right away, so there is never a hole
+	int stride = textureSize(placeholderCells);
+	std::vector<float> heights((size_t)stride * stride);
+	sampleTile(*sampler, key.x, key.z, placeholderCells, heights.data(), tile.bounds);
+
+	tile.placeholder = std::make_unique<HeightTexture>();
+	tile.placeholder->upload(stride, heights.data());
+	memoryBytes += textureBytes(placeholderCells);
+
+	TileData stored;
+	tile.stored = store.find(key.x, key.z, stored);
+	return tile;
+}
+
+
+void TileWorld::startJob(TileKey key, Tile& tile)
+{
+	auto cancelled = std::make_shared<std::atomic<bool>>(false);
+	tile.cancelled = cancelled;
+	pendingCount++;
+
+	std::shared_ptr<const HeightfieldSampler> jobSampler = sampler;
+	int cells = gridCells;
+	pool->submit([this, key, cancelled, jobSampler, cells]() {
+		PROFILE_ZONE("tile job");
+		int stride = textureSize(cells);
+		TileResult result;
+		result.key = key;
+		result.cancelled = cancelled;
+		result.heights.resize((size_t)stride * stride);
+		if (!sampleTile(*jobSampler, key.x, key.z, cells, result.heights.data(), result.bounds, cancelled.get())) {
+			return;
+		}
+		PROFILE_COUNT("noise samples", result.heights.size() * jobSampler->octaves());
+
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.push_back(std::move(result));
+	});
+}
+
+
+void TileWorld::cancelJob(Tile& tile)
+{
+	if (tile.cancelled) {
+		tile.cancelled->store(true, std::memory_order_relaxed);
+		tile.cancelled.reset();
+		pendingCount--;
+	}
+}
+
+
+void TileWorld::evict(TileKey key)
+{
+	Tile& tile = tiles.at(key);
+	cancelJob(tile);
+	memoryBytes -= textureBytes(placeholderCells);
+	if (tile.texture) {
+		memoryBytes -= textureBytes(gridCells);
+	}
+	lru.erase(tile.lru);
+	tiles.erase(key);
+}
+
+
+void TileWorld::uploadFinished(size_t budget)
+{
+	// Stored tiles share the upload budget with the jobs, they are copied
+	// out of the mapping by the upload itself
+	int uploads = 0;
+	for (TileKey key : wanted) {
+		Tile& tile = tiles.at(key);
+		TileData stored;
+		if (uploads == MaxUploadsPerFrame || tile.texture || !tile.stored || !store.find(key.x, key.z, stored)) {
+			continue;
+		}
+		tile.texture = std::make_unique<HeightTexture>();
+		tile.texture->upload(textureSize(gridCells), stored.heights);
+		tile.bounds = stored.bounds;
+		memoryBytes += textureBytes(gridCells);
+		uploads++;
+	}
+
+	// Results of cancelled jobs are dropped, the rest waits for a later
+	// frame once the upload budget is used up
+	std::vector<TileResult> ready;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		std::vector<TileResult> later;
+		for (TileResult& result : finished) {
+			auto it = tiles.find(result.key);
+			if (it == tiles.end() || it->second.cancelled != result.cancelled) {
+				continue;
+			}
+			if (uploads + (int)ready.size() < MaxUploadsPerFrame) {
+				ready.push_back(std::move(result));
+			}
+			else {
+				later.push_back(std::move(result));
+			}
+		}
+		finished = std::move(later);
+	}
+
+	for (TileResult& result : ready) {
+		Tile& tile = tiles.at(result.key);
+		tile.texture = std::make_unique<HeightTexture>();
+		tile.texture->upload(textureSize(gridCells), result.heights.data());
+		tile.bounds = result.bounds;
+		tile.cancelled.reset();
+		pendingCount--;
+		memoryBytes += textureBytes(gridCells);
+
+		// A tile evicted before the store was written may come back
+		bool known = std::any_of(unsaved.begin(), unsaved.end(), [&](const TileResult& other) {
+			return other.key == result.key;
+		});
+		if (layout.tileStore && !known && unsavedBytes + result.heights.size() * sizeof(float) <= budget) {
+			unsavedBytes += result.heights.size() * sizeof(float);
+			unsaved.push_back(std::move(result));
+		}
+	}
+}
+
+
+void TileWorld::draw(GLuint program, GLenum mode, const Frustum& frustum)
+{
+	placeholdersDrawn = 0;
+	glm::vec2 tileSize((float)layout.width, (float)layout.height);
+
+	for (TileKey key : wanted) {
+		Tile& tile = tiles.at(key);
+		glm::vec2 centre = glm::vec2((float)key.x, (float)key.z) * tileSize;
+		glm::vec3 low(centre.x - tileSize.x / 2.0f, tile.bounds.x, centre.y - tileSize.y / 2.0f);
+		glm::vec3 high(centre.x + tileSize.x / 2.0f, tile.bounds.y, centre.y + tileSize.y / 2.0f);
+		if (!frustum.intersects(low, high)) {
+			continue;
+		}
+
+		if (tile.texture) {
+			drawTile(program, mode, key, *tile.texture, grid, gridCells);
+		}
+		else {
+			drawTile(program, mode, key, *tile.placeholder, placeholderGrid, placeholderCells);
+			placeholdersDrawn++;
+		}
+	}
+
+	// Nothing else drawn with the program is offset or has an apron
+	glUniform2f(glGetUniformLocation(program, "tileOffset"), 0.0f, 0.0f);
+	glUniform1i(glGetUniformLocation(program, "apron"), 0);
+}
+
+
+void TileWorld::drawTile(GLuint program, GLenum mode, TileKey key, HeightTexture& heights, GPU_Geometry& geom, int cells)
+{
+	heights.bind(1);
+	glUniform1i(glGetUniformLocation(program, "gridSize"), cells + 1);
+	glUniform1i(glGetUniformLocation(program, "apron"), 1);
+	glUniform2f(glGetUniformLocation(program, "tileOffset"),
+		(float)key.x * (float)layout.width, (float)key.z * (float)layout.height);
+
+	if (mode == GL_POINTS) {
+		geom.bind();
+		glDrawArrays(GL_POINTS, 0, (cells + 1) * (cells + 1));
+		DrawStats::count(GL_POINTS, (cells + 1) * (cells + 1));
+	}
+	else {
+		geom.drawElements(mode);
+	}
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Endless terrain made of tiles around the camera (config world 1).
+//
+// Every tile is width x height world units with subdivisions quads per side,
+// and samples the ridged multifractal in world coordinates without the
+// mountain's falloff, so tiles fit together seamlessly. Tiles within
+// tileRadius of the camera tile are generated as jobs on a ThreadPool of
+// their own, nearest first, and drawn from a height texture each like
+// vertexFormat 2. The textures hold one extra ring of the neighbouring
+// tiles' heights, so normals on the tile edges match on both sides. Until a
+// tile is ready it is drawn from a coarse placeholder, which takes a few
+// hundred noise samples and is made on the spot. Finished tiles stay cached
+// after the camera moves on and the least recently used ones are dropped
+// once tileCacheMB is exceeded.
+//
+// Nothing here waits for a job: update() only takes what is finished, and at
+// most a few uploads per frame.
+//
+// With config tileStore 1 finished tiles are also kept on the CPU and written
+// to a TileStore when the settings change or the world goes away. Tiles found
+// in the store are uploaded straight from the mapped file instead of being
+// generated.
+//------------------------------------------------------------------------------
+
+#include "config.h"
+#include "Frustum.h"
+#include "Geometry.h"
+#include "Heightfield.h"
+#include "HeightTexture.h"
+#include "ThreadPool.h"
+#include "TileStore.h"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+class TileWorld {
+
+public:
+	TileWorld();
+	// Cancels queued jobs and waits for the running ones
+	~TileWorld();
+
+	// The worker threads can't be copied or moved
+	TileWorld(const TileWorld&) = delete;
+	TileWorld& operator=(const TileWorld&) = delete;
+
+	// Once per frame on the GL thread before draw(). Starts from scratch when
+	// the noise or tile layout of cfg changed, queues the missing tiles
+	// around cameraPos, uploads finished ones and evicts over the budget.
+	void update(const config& cfg, glm::vec3 cameraPos);
+
+	// Draws the tiles around the camera that intersect the frustum with the
+	// bound test.vert program, set up for vertexFormat 2
+	void draw(GLuint program, GLenum mode, const Frustum& frustum);
+
+	size_t getTileCount() const { return tiles.size(); }
+	size_t getPendingCount() const { return pendingCount; }
+	size_t getPlaceholderCount() const { return placeholdersDrawn; }
+	size_t getMemoryBytes() const { return memoryBytes; }
+
+private:
+	struct TileKey {
+		int x;
+		int z;
+
+		bool operator==(const TileKey& other) const { return x == other.x && z == other.z; }
+	};
+
+	struct TileKeyHash {
+		size_t operator()(const TileKey& key) const {
+			return std::hash<unsigned long long>()(((unsigned long long)(unsigned)key.x << 32) | (unsigned)key.z);
+		}
+	};
+
+	// Heights of one tile from a job
+	struct TileResult {
+		TileKey key;
+		std::shared_ptr<std::atomic<bool>> cancelled;
+		std::vector<float> heights;
+		glm::vec2 bounds;
+	};
+
+	struct Tile {
+		std::unique_ptr<HeightTexture> texture;     // full resolution, null until the job finished
+		std::unique_ptr<HeightTexture> placeholder; // placeholderCells quads per side, drawn until texture is there
+		glm::vec2 bounds = glm::vec2(0.0f);         // min and max height of what is drawn
+		std::shared_ptr<std::atomic<bool>> cancelled; // of the queued or running job, null when there is none
+		bool stored = false;                        // in the store, uploaded from there instead of a job
+		std::list<TileKey>::iterator lru;
+		unsigned lastUsed = 0;                      // frame that last wanted the tile
+	};
+
+	// Quads per side of the placeholders
+	static constexpr int PlaceholderCells = 16;
+	// Texture uploads per update(), each one up to (subdivisions+3)^2 floats
+	static constexpr int MaxUploadsPerFrame = 2;
+
+	config layout;                 // noise and tile settings the tiles were made with
+	bool configured;
+	std::shared_ptr<const HeightfieldSampler> sampler;
+	unsigned frame;
+
+	std::unordered_map<TileKey, Tile, TileKeyHash> tiles;
+	std::list<TileKey> lru;        // most recently wanted first
+	std::vector<TileKey> wanted;   // tiles around the camera, nearest first
+	size_t memoryBytes;
+	size_t pendingCount;
+	size_t placeholdersDrawn;
+
+	// Shared grids of the full tiles and the placeholders, no attributes
+	GPU_Geometry grid;
+	GPU_Geometry placeholderGrid;
+	int gridCells;
+	int placeholderCells;
+
+	std::mutex finishedMutex;
+	std::vector<TileResult> finished;
+
+	// Generated tiles not in the store yet, for config tileStore 1. Capped
+	// at tileCacheMB, later tiles just aren't stored.
+	TileStore store;
+	std::vector<TileResult> unsaved;
+	size_t unsavedBytes;
+
+	void reset(const config& cfg);
+	void saveTiles();
+	Tile& createTile(TileKey key);
+	void startJob(TileKey key, Tile& tile);
+	void cancelJob(Tile& tile);
+	void evict(TileKey key);
+	// Uploads stored tiles, nearest first, then finished jobs. budget caps
+	// what is kept for the store.
+	void uploadFinished(size_t budget);
+	void setupGrid(GPU_Geometry& geom, int cells);
+	void drawTile(GLuint program, GLenum mode, TileKey key, HeightTexture& heights, GPU_Geometry& geom, int cells);
+
+	// Declared last so the workers stop before the state they report to
+	std::unique_ptr<ThreadPool> pool;
+};
@@ -1,5 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 struct Vertex {
 	float x, y, z;    // position
 	float nx, ny, nz;   // normal
 	float r, g, b, a; // color (RGBA)
 };
+
+// Compact interleaved vertex for the terrain grid, 8 bytes instead of the
+// 32 bytes of the separate position/normal/texcoord streams.
+//
+// x, z and the texture coordinates are not stored at all, test.vert rebuilds
+// them from gl_VertexID and the grid size.
+struct PackedTerrainVertex {
+	uint16_t height;    // unorm16 across the mesh's [min, max] height range
+	uint16_t padding;   // keeps the normal 4-byte aligned
+	int16_t normal[2];  // snorm16 octahedral encoding, y is the folded axis
+};
+
+// Octahedral normal encoding folded around y, the terrain's up axis:
+// project onto |x| + |y| + |z| = 1, keep (x, z) and fold the lower half
+// over the diagonals. test.vert has the matching decodeOctahedral().
+inline glm::vec2 encodeOctahedral(const glm::vec3& n)
+{
+	float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	glm::vec2 p(n.x / l1, n.z / l1);
+	if (n.y < 0.0f) {
+		glm::vec2 folded(
+			(1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f)
+		);
+		p = folded;
+	}
+	return p;
+}
+
+inline PackedTerrainVertex packTerrainVertex(float height, float minHeight, float heightRange, const glm::vec3& normal)
+{
+	auto snorm16 = [](float v) {
+		return (int16_t)std::lround(std::min(std::max(v, -1.0f), 1.0f) * 32767.0f);
+	};
+
+	float h = heightRange > 0.0f ? (height - minHeight) / heightRange : 0.0f;
+	glm::vec2 oct = encodeOctahedral(normal);
+
+	PackedTerrainVertex v;
+	v.height = (uint16_t)std::lround(std::min(std::max(h, 0.0f), 1.0f) * 65535.0f);
+	v.padding = 0;
+	v.normal[0] = snorm16(oct.x);
+	v.normal[1] = snorm16(oct.y);
+	return v;
+}
@@ -1,10 +1,14 @@
 #include "VertexBuffer.h"
 
+#include "GLCompute.h"
+
 #include <utility>
 
 
 VertexBuffer::VertexBuffer(GLuint index, GLint size, GLenum dataType)
 	: bufferID{}
+	, capacity(0)
+	, mapped(false)
 {
 	bind();
 	glVertexAttribPointer(index, size, dataType, GL_FALSE, 0, (void*)0);
@@ -12,7 +16,60 @@ VertexBuffer::VertexBuffer(GLuint index, GLint size, GLenum dataType)
 }
 
 
+VertexBuffer::VertexBuffer()
+	: bufferID{}
+	, capacity(0)
+	, mapped(false)
+{}
+
+
 void VertexBuffer::uploadData(GLsizeiptr size, const void* data, GLenum usage) {
 	bind();
 	glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+	capacity = size;
+}
+
+
+void* VertexBuffer::mapForWrite(GLsizeiptr size, GLenum usage) {
+	bind();
+	if (mapped) {
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mapped = false;
+	}
+	if (size != capacity) {
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, usage);
+		capacity = size;
+	}
+
+	void* data = glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	mapped = data != nullptr;
+	return data;
+}
+
+
+bool VertexBuffer::unmap() {
+	if (!mapped) {
+		return true;
+	}
+	bind();
+	mapped = false;
+	return glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+}
+
+
+void VertexBuffer::bindStorage(GLuint binding, GLsizeiptr size, GLenum usage) {
+	unmap();
+	if (size != capacity) {
+		bind();
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, usage);
+		capacity = size;
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bufferID);
+}
+
+
+void VertexBuffer::readData(GLintptr offset, GLsizeiptr size, void* data) const {
+	bind();
+	glGetBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
 }
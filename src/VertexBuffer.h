@@ -11,6 +11,9 @@ class VertexBuffer {
 
 public:
 	VertexBuffer(GLuint index, GLint size, GLenum dataType);
+	// Buffer without an attribute of its own, for interleaved layouts that
+	// set up their attribute pointers after the upload
+	VertexBuffer();
 
 	// Because we're using the VertexBufferHandle to do RAII for the buffer for us
 	// and our other types are trivial or provide their own RAII
@@ -23,7 +26,29 @@ public:
 	void bind() const { glBindBuffer(GL_ARRAY_BUFFER, bufferID); }
 	void uploadData(GLsizeiptr size, const void* data, GLenum usage);
 
+	// Zero-copy alternative to uploadData: (re)allocates size bytes and maps
+	// them write-only, invalidated and unsynchronized. The caller has to make
+	// sure the GPU is done with the old contents (see SyncHandle). The pointer
+	// may be written from any thread until unmap(). Returns null on failure.
+	void* mapForWrite(GLsizeiptr size, GLenum usage);
+	// False when the contents got lost while mapped and need to be rewritten
+	bool unmap();
+	bool isMapped() const { return mapped; }
+	// Bytes allocated by the last upload, mapping or bindStorage
+	GLsizeiptr getCapacity() const { return capacity; }
+
+	// Binds the buffer to another target, e.g. GL_PIXEL_UNPACK_BUFFER
+	void bindAs(GLenum target) const { glBindBuffer(target, bufferID); }
+	// (Re)allocates size bytes when the size changed, keeping the contents
+	// otherwise, and binds them to shader storage binding point 'binding'
+	// for a compute shader. Needs GLCompute::available().
+	void bindStorage(GLuint binding, GLsizeiptr size, GLenum usage);
+	// Copies size bytes at offset into data, waits for the GPU to write them
+	void readData(GLintptr offset, GLsizeiptr size, void* data) const;
+
 private:
 	VertexBufferHandle bufferID;
+	GLsizeiptr capacity;
+	bool mapped;
 };
 
@@ -1,5 +1,7 @@
 #include "Window.h"
 
+#include "GLCompute.h"
+#include "GLTessellation.h"
 #include "Log.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_glfw.h"
@@ -54,14 +56,22 @@ Window::Window(
 	, callbacks(callbacks)
 {
 	// specify OpenGL version
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // needed for mac?
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
 
-	// create window
-	window = std::unique_ptr<GLFWwindow, WindowDeleter>(glfwCreateWindow(width, height, title, monitor, share));
+	// create window, 4.3 for compute shader generation, 4.1 (the newest
+	// macOS has) for the tessellation path and 3.3 where neither is available
+	const int versions[][2] = { { 4, 3 }, { 4, 1 }, { 3, 3 } };
+	for (const auto& version : versions) {
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+		window = std::unique_ptr<GLFWwindow, WindowDeleter>(glfwCreateWindow(width, height, title, monitor, share));
+		if (window != nullptr) {
+			break;
+		}
+		Log::warn("WINDOW no OpenGL {}.{} core context", version[0], version[1]);
+	}
 	if (window == nullptr) {
 		Log::error("WINDOW failed to create GLFW window");
 		throw std::runtime_error("Failed to create GLFW window.");
@@ -78,6 +88,8 @@ Window::Window(
 	if (!gladLoadGL()) {
 		throw std::runtime_error("Failed to initialize GLAD");
 	}
+	GLTessellation::load();
+	GLCompute::load();
 
 	glfwSetWindowSizeCallback(window.get(), defaultWindowSizeCallback);
 
@@ -25,6 +25,78 @@ config loadConfig(const std::string& path) {
 		>> cfg.dotSize
 		>> cfg.type;
 
+	// Newer settings are optional so older config files keep working. A
+	// missing value leaves the stream failed and the default untouched.
+	in >> cfg.threads
+		>> cfg.simd
+		>> cfg.vertexFormat
+		>> cfg.noiseCacheMB
+		>> cfg.asyncRegen
+		>> cfg.keepCpuGeometry
+		>> cfg.normalMode
+		>> cfg.lodError
+		>> cfg.generator
+		>> cfg.world
+		>> cfg.tileRadius
+		>> cfg.tileCacheMB
+		>> cfg.tileStore;
+
 	// You could add more robust parsing (e.g., checking if the read failed).
 	return cfg;
 }
+
+ConfigChange classifyChange(const config& before, const config& after) {
+	if (before.width != after.width
+		|| before.height != after.height
+		|| before.subdivisions != after.subdivisions
+		|| before.vertexFormat != after.vertexFormat
+		|| before.world != after.world) {
+		return ConfigChange::Topology;
+	}
+
+	if (before.seed != after.seed
+		|| before.octaves != after.octaves
+		|| before.frequency != after.frequency
+		|| before.lacunarity != after.lacunarity
+		|| before.gain != after.gain
+		|| before.ridgeOffset != after.ridgeOffset
+		|| before.simd != after.simd
+		|| before.keepCpuGeometry != after.keepCpuGeometry
+		|| before.normalMode != after.normalMode
+		|| before.generator != after.generator) {
+		return ConfigChange::Height;
+	}
+
+	// The single mountain only writes the store when it builds, the terrain
+	// on screen would otherwise never get there
+	if (!after.world && !before.tileStore && after.tileStore) {
+		return ConfigChange::Height;
+	}
+
+	if (before.dotSize != after.dotSize
+		|| before.type != after.type
+		|| before.threads != after.threads
+		|| before.noiseCacheMB != after.noiseCacheMB
+		|| before.asyncRegen != after.asyncRegen
+		|| before.lodError != after.lodError
+		|| before.tileRadius != after.tileRadius
+		|| before.tileCacheMB != after.tileCacheMB
+		|| before.tileStore != after.tileStore) {
+		return ConfigChange::Render;
+	}
+
+	return ConfigChange::None;
+}
+
+
+void copyRenderSettings(config& to, const config& from) {
+	to.dotSize = from.dotSize;
+	to.type = from.type;
+	to.threads = from.threads;
+	to.noiseCacheMB = from.noiseCacheMB;
+	to.asyncRegen = from.asyncRegen;
+	to.lodError = from.lodError;
+	to.tileRadius = from.tileRadius;
+	to.tileCacheMB = from.tileCacheMB;
+	to.tileStore = from.tileStore;
+}
@@ -14,6 +14,39 @@ struct config {
 	int subdivisions = 100;
 	int dotSize = 5;
 	int type = 0;
+	int threads = 0;         // generation threads, 0 = one per hardware thread
+	int simd = 1;            // 1 = batched SIMD float noise, 0 = scalar double noise
+	int vertexFormat = 0;    // 0 = float position/normal/texcoord streams, 1 = packed 8-byte vertices,
+	                         // 2 = height texture displacing a static grid, 3 = height texture on CDLOD patches,
+	                         // 4 = height texture on hardware tessellated patches (GL 4, falls back to 3)
+	int noiseCacheMB = 256;  // memory for cached per-octave noise layers, 0 = off
+	int asyncRegen = 1;      // 1 = regenerate on a background thread while drawing the old terrain
+	int keepCpuGeometry = 0; // 1 = keep vertices in mountain::m_cpu_geom, 0 = generate straight into GL buffers
+	int normalMode = 1;      // 0 = serial triangle scatter, 1 = six-triangle grid gather, 2 = central differences,
+	                         // 3 = analytic, from noise derivatives in the height pass
+	int lodError = 4;        // vertexFormats 3 and 4: on-screen grid spacing in pixels before a finer level is used
+	int generator = 0;       // 0 = CPU, 1 = compute shaders (GL 4.3, not vertexFormat 1, falls back to the CPU)
+	int world = 0;           // 0 = one mountain, 1 = endless tiles of width x height around the camera (see TileWorld)
+	int tileRadius = 2;      // world 1: tiles kept around the camera tile in every direction
+	int tileCacheMB = 256;   // world 1: memory for generated tiles, least recently used ones go first
+	int tileStore = 0;       // 1 = keep CPU generated heights in tilestore/ and load them instead of regenerating (see TileStore)
 };
 
 config loadConfig(const std::string& path);
+
+// What an edit to the config invalidates, from cheapest to most expensive.
+// Each class also redoes the work of the ones before it.
+enum class ConfigChange {
+	None,
+	Render,    // dotSize, type, threads, noiseCacheMB, asyncRegen, lodError, tileRadius, tileCacheMB, tileStore: no regen
+	Height,    // noise parameters, keepCpuGeometry, normalMode, generator, tileStore turned on for the
+	           // single mountain: new heights on the same grid
+	Topology   // width, height, subdivisions, vertexFormat, world: full rebuild
+};
+
+// Classifies the difference between two configs by the most expensive
+// field that changed
+ConfigChange classifyChange(const config& before, const config& after);
+
+// Copies the fields classified as ConfigChange::Render
+void copyRenderSettings(config& to, const config& from);
@@ -2,22 +2,31 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <list>
 #include <vector>
 #include <limits>
 #include <functional>
-#include <filesystem> // C++17
+#include <cmath>
+#include <memory>
+#include <stdexcept>
 
 #include "Geometry.h"
 #include "GLDebug.h"
+#include "GpuTimer.h"
 #include "Log.h"
+#include "Profiler.h"
 #include "ShaderProgram.h"
 #include "Shader.h"
 #include "Texture.h"
 #include "Window.h"
 #include "Camera.h"
+#include "ConfigWatcher.h"
+#include "DrawStats.h"
+#include "PerfOverlay.h"
+#include "GLTessellation.h"
 
 #include "glm/glm.hpp"
 #include "glm/gtc/type_ptr.hpp"
@@ -31,14 +40,38 @@ class Assignment4 : public CallbackInterface {
 public:
 	Assignment4()
 		: camera(glm::radians(45.f), glm::radians(45.f), 3.0)
-		, aspect(1.0f)
 		, rightMouseDown(false)
 		, leftMouseDown(false)
+		, aspect(1.0f)
+		, fovy(glm::radians(45.0f))
 		, mouseOldX(0.0)
 		, mouseOldY(0.0)
+		, moveKeys{ false, false, false, false }
 	{}
 
-	virtual void keyCallback(int key, int scancode, int action, int mods) override {}
+	virtual void keyCallback(int key, int scancode, int action, int mods) override {
+		// WASD flies over the terrain, see moveCamera()
+		const int keys[] = { GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D };
+		for (int i = 0; i < 4; i++) {
+			if (key == keys[i] && action == GLFW_PRESS)        moveKeys[i] = true;
+			else if (key == keys[i] && action == GLFW_RELEASE) moveKeys[i] = false;
+		}
+		// F1 shows and hides the performance overlay
+		if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+			overlay.toggle();
+		}
+#ifdef MOUNTAIN_PROFILE
+		// P writes the recent profiling zones of all threads
+		if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+			if (Profiler::writeChromeTrace("mountain.trace.json")) {
+				Log::info("Wrote profile to mountain.trace.json");
+			}
+			else {
+				Log::error("Could not write mountain.trace.json");
+			}
+		}
+#endif
+	}
 	virtual void mouseButtonCallback(int button, int action, int mods) override {
 		if (button == GLFW_MOUSE_BUTTON_RIGHT) {
 			if (action == GLFW_PRESS)            rightMouseDown = true;
@@ -79,7 +112,7 @@ public:
 	void viewPipeline(ShaderProgram& sp) {
 		glm::mat4 M = glm::mat4(1.0);
 		glm::mat4 V = camera.getView();
-		glm::mat4 P = glm::perspective(glm::radians(45.0f), aspect, 0.01f, 1000.f);
+		glm::mat4 P = getProjection();
 
 		// Send to shader
 		glUniformMatrix4fv(glGetUniformLocation(sp, "M"), 1, GL_FALSE, glm::value_ptr(M));
@@ -87,17 +120,55 @@ public:
 		glUniformMatrix4fv(glGetUniformLocation(sp, "P"), 1, GL_FALSE, glm::value_ptr(P));
 	}
 
+	glm::mat4 getProjection() const {
+		return glm::perspective(fovy, aspect, 0.01f, 1000.f);
+	}
+
+	// Moves the camera along the ground for the held WASD keys, forward
+	// being where it looks. Faster the further out it orbits.
+	void moveCamera(float dt) {
+		glm::vec3 forward = camera.getOrigin() + camera.getTarget() - camera.getPos();
+		forward.y = 0.0f;
+		if (glm::dot(forward, forward) < 1e-6f) {
+			// Looking straight down
+			forward = glm::vec3(0.0f, 0.0f, -1.0f);
+		}
+		forward = glm::normalize(forward);
+		glm::vec3 right = glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f));
+
+		glm::vec3 direction(0.0f);
+		if (moveKeys[0]) direction += forward;
+		if (moveKeys[1]) direction -= right;
+		if (moveKeys[2]) direction -= forward;
+		if (moveKeys[3]) direction += right;
+		if (glm::dot(direction, direction) == 0.0f) {
+			return;
+		}
+
+		float speed = std::max(glm::length(camera.getPos() - camera.getOrigin()), 10.0f);
+		camera.move(glm::normalize(direction) * speed * dt);
+	}
+
+	// Pixels covered by one world unit at distance 1, for level of detail
+	float projectionScale(int viewportHeight) const {
+		return float(viewportHeight) / (2.0f * std::tan(fovy / 2.0f));
+	}
+
 	Camera camera;
+	PerfOverlay overlay;
 private:
 	bool rightMouseDown;
 	bool leftMouseDown;
 	float aspect;
+	float fovy;
 	double mouseOldX;
 	double mouseOldY;
+	bool moveKeys[4]; // W, A, S, D held
 };
 
 int main() {
 	Log::debug("Starting main");
+	PROFILE_THREAD_NAME("render");
 
 	// WINDOW
 	glfwInit();
@@ -112,62 +183,115 @@ int main() {
 	// SHADERS
 	ShaderProgram shader("shaders/test.vert", "shaders/test.frag");
 
+	// Hardware tessellation for vertexFormat 4, needs a GL 4 context
+	std::unique_ptr<ShaderProgram> tessShader;
+	if (GLTessellation::available()) {
+		try {
+			tessShader = std::make_unique<ShaderProgram>("shaders/terrain.vert", "shaders/terrain.tesc",
+				"shaders/terrain.tese", "shaders/test.frag");
+		}
+		catch (std::runtime_error&) {
+			Log::warn("SHADER_PROGRAM no tessellation shaders, vertexFormat 4 falls back to 3");
+		}
+	}
+
 	// MOUNTAIN
 	// The constructor presumably loads geometry or sets up VAOs, etc.
 	mountain mountain1("mountain1", "textures/rock.jpg", GL_LINEAR);
 	config currentConfig = loadConfig("config.txt");
+	mountain1.enableTessellation(tessShader != nullptr);
 	mountain1.updateConfig(currentConfig);
 
 	/*mountain Mountain2("mountain2", "textures/rock.png", GL_LINEAR);
 	Mountain2.updateConfig(currentConfig);*/
 
-	std::filesystem::file_time_type lastWriteTime;
-	try {
-		lastWriteTime = std::filesystem::last_write_time("config.txt");
-	}
-	catch (std::filesystem::filesystem_error& e) {
-		std::cerr << "Error getting file time: " << e.what() << std::endl;
-	}
+	// Reloads the config and recompiles the shaders when their files change
+	ConfigWatcher watcher("config.txt", { "shaders/test.vert", "shaders/test.frag",
+		"shaders/terrain.vert", "shaders/terrain.tesc", "shaders/terrain.tese",
+		"shaders/terrain_heights.comp", "shaders/terrain_vertices.comp", "shaders/terrain_bounds.comp" });
+
+	// GPU time of the passes, read back a few frames late
+	GpuTimer gpuTimer;
+
 	// RENDER LOOP
+	double lastFrameTime = glfwGetTime();
 	while (!window.shouldClose()) {
+		PROFILE_ZONE("frame");
 		glfwPollEvents();
-		try {
-			auto newWriteTime = std::filesystem::last_write_time("config.txt");
-			if (newWriteTime != lastWriteTime) {
-				std::cout << "Config file changed. Reloading...\n";
-				currentConfig = loadConfig("config.txt");
-				lastWriteTime = newWriteTime;
 
-				 mountain1.updateConfig(currentConfig);
+		double frameTime = glfwGetTime();
+		double frameInterval = frameTime - lastFrameTime;
+		a4->moveCamera((float)frameInterval);
+		lastFrameTime = frameTime;
+		DrawStats::beginFrame();
+
+		if (watcher.takeConfig(currentConfig)) {
+			PROFILE_ZONE("config reload");
+			std::cout << "Config file changed. Reloading...\n";
+
+			// In async mode the old terrain stays on screen until the
+			// new one is ready
+			if (currentConfig.asyncRegen) {
+				mountain1.requestConfig(currentConfig);
+			}
+			else {
+				mountain1.updateConfig(currentConfig);
 			}
 		}
-		catch (std::filesystem::filesystem_error& e) {
-			std::cerr << "Error checking file time: " << e.what() << std::endl;
+		if (watcher.takeShadersChanged()) {
+			// A program that fails to build keeps its previous version
+			shader.recompile();
+			if (tessShader) {
+				tessShader->recompile();
+			}
+			mountain1.recompileComputeShaders();
+		}
+		{
+			PROFILE_ZONE("poll regeneration");
+			mountain1.pollRegeneration();
 		}
 
 		glEnable(GL_LINE_SMOOTH);
 		glEnable(GL_FRAMEBUFFER_SRGB);
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		gpuTimer.begin("clear");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gpuTimer.end();
 		glEnable(GL_DEPTH_TEST);
-		glUniform3fv(glGetUniformLocation(shader, "lightPos"), 1, glm::value_ptr(glm::vec3(10.0f, 10.0f, 3.0f)));
-		glUniform3fv(glGetUniformLocation(shader, "viewPos"), 1, glm::value_ptr(a4->camera.getPos()));
-		glUniform3fv(glGetUniformLocation(shader, "lightColor"), 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+		ShaderProgram& program = mountain1.usesTessellation() ? *tessShader : shader;
+		program.use();
+
+		glUniform3fv(glGetUniformLocation(program, "lightPos"), 1, glm::value_ptr(glm::vec3(10.0f, 10.0f, 3.0f)));
+		glUniform3fv(glGetUniformLocation(program, "viewPos"), 1, glm::value_ptr(a4->camera.getPos()));
+		glUniform3fv(glGetUniformLocation(program, "lightColor"), 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
 
-		shader.use();
-		a4->viewPipeline(shader);
+		a4->viewPipeline(program);
+		mountain1.setShaderUniforms(program);
+		// The terrain is drawn with an identity model matrix, see viewPipeline
+		mountain1.setView(a4->camera.getPos(), a4->getProjection() * a4->camera.getView(),
+			a4->projectionScale(window.getHeight()));
 
-		mountain1.m_gpu_geom.bind();
 		mountain1.texture.bind();
 		glPointSize(currentConfig.dotSize);
-		if (currentConfig.type == 0) glDrawArrays(GL_POINTS, 0, mountain1.m_size);
-		if (currentConfig.type == 1) glDrawArrays(GL_TRIANGLES, 0, mountain1.m_size);
+		gpuTimer.begin("terrain");
+		mountain1.draw();
+		gpuTimer.end();
 		mountain1.texture.unbind();
 		
 		mountain1.texture.unbind();
 
 		glDisable(GL_FRAMEBUFFER_SRGB); // disable sRGB for anything else
-		window.swapBuffers();
+
+		// Everything up to here is the frame's CPU time, the overlay itself
+		// isn't part of it
+		gpuTimer.endFrame();
+		a4->overlay.addFrame((float)(frameInterval * 1000.0), (float)((glfwGetTime() - frameTime) * 1000.0),
+			gpuTimer.totalMilliseconds());
+		a4->overlay.draw(mountain1, gpuTimer);
+		{
+			PROFILE_ZONE("swap");
+			window.swapBuffers();
+		}
 	}
 
 	glfwTerminate();
@@ -1,4 +1,7 @@
 #include "mountain.h"
+#include "DrawStats.h"
+#include "Profiler.h"
+#include "TerrainMesh.h"
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/random.hpp>
 #include <iostream>
@@ -12,25 +15,17 @@
 #include <cmath>
 #include <algorithm> 
 #include <chrono>
+#include <limits>
+#include <mutex>
 #include <thread>
 #include <random>
 
 float mountain::ridge(float h, float offset)
 {
-	h = offset - std::fabs(h);
-
-	if (h < 0.5f) {
-		// 4 * h^3
-		return 4.0f * h * h * h;
-	}
-	else {
-		// (h - 1) * (2h - 2)^2 + 1
-		float term = (2.0f * h - 2.0f);
-		return (h - 1.0f) * term * term + 1.0f;
-	}
+	return ::ridge(h, offset);
 }
 
-float mountain::ridgedMF(float x, float y, SimplexNoise noise)
+float mountain::ridgedMF(float x, float y, const SimplexNoise& noise)
 {
 	float sum = 0.0f;
 	float amp = 0.5f;
@@ -62,187 +57,853 @@ void mountain::computeNormals(
 	std::vector<glm::vec3>& normals,
 	std::vector<glm::vec3>& verts)
 {
-	// Reset normals
-	for (auto& v : normals) {
-		v.x = 0.0f;
-		v.y = 0.0f;
-		v.z = 0.0f;
+	scatterNormals(indices, normals, verts);
+}
+
+void mountain::computeGridNormals(
+	int subdivisions,
+	std::vector<glm::vec3>& normals,
+	const std::vector<glm::vec3>& verts)
+{
+	gridNormals(threadPool(), subdivisions, normals.data(), [&](int i) { return verts[i]; });
+}
+
+void mountain::computeHeightNormals(
+	int subdivisions,
+	glm::vec2 spacing,
+	const std::vector<float>& heights,
+	std::vector<glm::vec3>& normals)
+{
+	centralDifferenceNormals(threadPool(), subdivisions, spacing.x, spacing.y, heights.data(), normals.data());
+}
+
+ThreadPool& mountain::threadPool()
+{
+	if (!pool) {
+		return threadPool(_config.threads);
 	}
+	return *pool;
+}
 
-	for (size_t i = 0; i < indices.size(); i += 3) {
-		unsigned int i0 = indices[i];
-		unsigned int i1 = indices[i + 1];
-		unsigned int i2 = indices[i + 2];
+ThreadPool& mountain::threadPool(int threads)
+{
+	if (!pool || poolThreads != threads) {
+		pool = std::make_unique<ThreadPool>(std::max(threads, 0));
+		poolThreads = threads;
+	}
+	return *pool;
+}
+
+void mountain::elevate()
+{
+	rebuild(_config);
+}
 
-		glm::vec3& v0 = verts[i0];
-		glm::vec3& v1 = verts[i1];
-		glm::vec3& v2 = verts[i2];
+void mountain::rebuild(const config& cfg)
+{
+	// Builds run one at a time, they share the pool, caches and grid
+	if (worker) {
+		worker->cancelAndWait();
+	}
+	if (cfg.world) {
+		// The tiles follow the camera from draw(), the slots keep the
+		// last single mountain
+		_config = cfg;
+		return;
+	}
+	if (generatesOnGpu(cfg)) {
+		present(buildOnGpu(cfg));
+		return;
+	}
+	TerrainTarget target = mapTarget(slots[1 - front], cfg, MapWaitTimeout);
+	present(build(cfg, target, CancelToken()));
+}
 
-		// Two edges of the triangle
-		float ux = v1.x - v0.x;
-		float uy = v1.y - v0.y;
-		float uz = v1.z - v0.z;
+bool mountain::generatesOnGpu(const config& cfg)
+{
+	if (cfg.generator != 1) {
+		return false;
+	}
+	if (!compute.ready() || !compute.supports(cfg)) {
+		std::cout << "Compute generation not available for this config, generating on the CPU\n";
+		return false;
+	}
+	return true;
+}
 
-		float vx = v2.x - v0.x;
-		float vy = v2.y - v0.y;
-		float vz = v2.z - v0.z;
+std::unique_ptr<TerrainBuild> mountain::buildOnGpu(const config& cfg)
+{
+	PROFILE_ZONE("gpu build");
+	auto start = std::chrono::high_resolution_clock::now();
 
-		// Cross product to get face normal
-		float nx = (uy * vz) - (uz * vy);
-		float ny = (uz * vx) - (ux * vz);
-		float nz = (ux * vy) - (uy * vx);
+	auto result = std::make_unique<TerrainBuild>();
+	result->cfg = cfg;
+	result->onGpu = true;
 
-		// Accumulate
-		normals[i0].x += nx;  normals[i0].y += ny;  normals[i0].z += nz;
-		normals[i1].x += nx;  normals[i1].y += ny;  normals[i1].z += nz;
-		normals[i2].x += nx;  normals[i2].y += ny;  normals[i2].z += nz;
+	bool reuseGrid = grid && grid->subdivisions == cfg.subdivisions && grid->vertexFormat == cfg.vertexFormat;
+	if (!reuseGrid) {
+		grid = generateGrid(cfg);
+	}
+	result->grid = grid;
+
+	// Nothing of a CPU build may still be mapped in the slot the GPU writes
+	TerrainSlot& slot = slots[1 - front];
+	slot.geom.unmapVertices();
+	slot.mapped = TerrainTarget();
+
+	result->lodTree = buildLODTree(cfg.subdivisions, compute.generate(cfg, slot.geom, slot.heightTexture));
+	const TerrainLODTree& tree = *result->lodTree;
+	glm::vec2 bounds = tree.nodeBounds(tree.levels - 1, 0, 0);
+	result->heightRange = glm::vec2(bounds.x, bounds.y - bounds.x);
+
+	// Reading the heights back stalls on the GPU, only done when a CPU copy
+	// was asked for
+	if (cfg.keepCpuGeometry) {
+		result->heights = compute.readHeights(cfg);
+		validateGpuHeights(*result);
 	}
 
-	 //Normalize the accumulated normals
-	for (auto& v : normals) {
-		float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-		if (length > 1e-6f) {
-			v.x /= length;
-			v.y /= length;
-			v.z /= length;
+	auto end = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsed = end - start;
+	std::cout << "GPU generation time: " << elapsed.count() << " s" << (reuseGrid ? " (grid reused)" : "") << "\n";
+	result->timings.total = elapsed.count();
+	result->timings.gridReused = reuseGrid;
+	return result;
+}
+
+void mountain::validateGpuHeights(const TerrainBuild& result)
+{
+	// Single precision noise on the GPU against whichever noise the CPU
+	// path is set to, in world units
+	constexpr float Tolerance = 1e-3f;
+
+	HeightfieldSampler sampler(result.cfg);
+	int gridSize = sampler.resolution();
+	std::vector<float> rowErrors(gridSize, 0.0f);
+	threadPool(result.cfg.threads).parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+		std::vector<float> reference(gridSize);
+		for (int row = rowBegin; row < rowEnd; row++) {
+			sampler.sampleRow(row, 0, gridSize, reference.data());
+			for (int col = 0; col < gridSize; col++) {
+				float error = std::fabs(reference[col] - result.heights[row * gridSize + col]);
+				rowErrors[row] = std::max(rowErrors[row], error);
+			}
 		}
+	});
+
+	float maxError = *std::max_element(rowErrors.begin(), rowErrors.end());
+	if (maxError <= Tolerance) {
+		std::cout << "GPU heights match the CPU, max error " << maxError << "\n";
+	}
+	else {
+		std::cerr << "Warning: GPU heights differ from the CPU by up to " << maxError << "\n";
 	}
 }
 
-void mountain::elevate()
+std::unique_ptr<TerrainBuild> mountain::build(const config& cfg, const TerrainTarget& target, const CancelToken& cancel)
 {
+	PROFILE_ZONE("build");
  	//start time
 	auto start = std::chrono::high_resolution_clock::now();
- 
-	SimplexNoise noise(_config.seed);
-	int width = _config.width;
-	int height = _config.height;
-	int subdivisions = _config.subdivisions;
-
-	// (subdivisions+1) x (subdivisions+1) grid
-	// store all vertices in a single vector
-	std::vector<glm::vec3> verts;
-	std::vector<glm::vec3> normals;
-	verts.resize((subdivisions + 1) * (subdivisions + 1));
-	normals.resize((subdivisions + 1) * (subdivisions + 1));
-
-	std::vector<glm::vec2> texcoords;
-	texcoords.resize((subdivisions + 1) * (subdivisions + 1));
-
-	// Generate vertex positions, heights, and (optionally) texcoords
-	for (int row = 0; row <= subdivisions; row++) {
-		for (int col = 0; col <= subdivisions; col++) {
-			// Index of the current vertex in the array
-			int index = row * (subdivisions + 1) + col;
-
-			float posX = col * (width / (float)subdivisions) - (width / 2.0f);
-			float posZ = row * (height / (float)subdivisions) - (height / 2.0f);
-
-			float x = (posX + (width / 2.0f)) / (float)width;
-			float y = (-(posZ)+(height / 2.0f)) / (float)height;
-
-			float h = ridgedMF(x, y, noise);
-
-			float distance = getDistance(x, y, 0.5f, 0.5f);
-			float falloff = std::min(1.0f - (distance / 0.5f), 1.0f);
-			if (falloff < 0.0f) {
-				falloff = 0.0f;
+
+	auto result = std::make_unique<TerrainBuild>();
+	result->cfg = cfg;
+	if (target.fits(cfg)) {
+		result->target = target;
+	}
+	ThreadPool& workers = threadPool(cfg.threads);
+
+	generateHeights(*result, cancel);
+	if (cancel.cancelled()) {
+		return nullptr;
+	}
+
+	//time after the heights
+	auto afterFirstLoop = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsedFirstLoop = afterFirstLoop - start;
+	std::cout << "Heights time: " << elapsedFirstLoop.count() << " s (" << workers.size() << " threads)\n";
+	result->timings.heights = elapsedFirstLoop.count();
+	result->timings.threads = (int)workers.size();
+
+	// Indices and texcoords only change with the grid
+	bool reuseGrid = grid && grid->subdivisions == cfg.subdivisions && grid->vertexFormat == cfg.vertexFormat;
+	if (!reuseGrid) {
+		grid = generateGrid(cfg);
+	}
+	result->grid = grid;
+
+	//time after the grid
+	auto afterSecondLoop = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsedSecondLoop = afterSecondLoop - afterFirstLoop;
+	std::cout << "Grid time: " << elapsedSecondLoop.count() << " s" << (reuseGrid ? " (grid reused)" : "") << "\n";
+	result->timings.grid = elapsedSecondLoop.count();
+	result->timings.gridReused = reuseGrid;
+
+	// The height texture formats displace a static grid or the CDLOD
+	// patches on the GPU and derive normals there, the other formats need
+	// full vertices
+	if (cfg.vertexFormat < 2) {
+		buildVertices(*result);
+	}
+	if (cancel.cancelled()) {
+		return nullptr;
+	}
+
+	//time after the vertices
+	auto thirdLoop = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsedThirdLoop = thirdLoop - afterSecondLoop;
+	std::cout << "Vertices time: " << elapsedThirdLoop.count() << " s\n";
+	result->timings.vertices = elapsedThirdLoop.count();
+
+	computeBounds(*result);
+	// Before packing, which drops the normals. Stored heights are written
+	// again when the build added normals to them.
+	if (cfg.tileStore && (!result->fromStore || (!result->normalsLoaded && !result->normals.empty()))) {
+		storeHeights(*result);
+	}
+	if (cfg.vertexFormat == 1) {
+		packVertices(*result);
+	}
+
+ 	//end time
+	auto end = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsed = end - start;
+	std::cout << "Build time: " << elapsed.count() << " s\n";
+	result->timings.finish = std::chrono::duration<double>(end - thirdLoop).count();
+	result->timings.total = elapsed.count();
+
+	return result;
+}
+
+void mountain::generateHeights(TerrainBuild& result, const CancelToken& cancel)
+{
+	PROFILE_ZONE("heights");
+	const config& cfg = result.cfg;
+	HeightfieldSampler sampler(cfg);
+	ThreadPool& workers = threadPool();
+
+	// (subdivisions+1) x (subdivisions+1) grid of heights, row by row
+	int gridSize = cfg.subdivisions + 1;
+	std::vector<float>& heights = result.heights;
+	if (cfg.tileStore && loadStoredHeights(result)) {
+		std::cout << "Heights loaded from " << TileStore::pathFor(cfg) << "\n";
+		return;
+	}
+	heights.resize(gridSize * gridSize);
+
+	// Analytic normals come out of the same pass as the heights
+	if (cfg.normalMode == 3 && cfg.vertexFormat < 2) {
+		// The tile store needs them in memory, mapped buffers are write only
+		// and can't be read back for it
+		glm::vec3* normals = result.target.normals;
+		if (!normals || cfg.tileStore) {
+			result.normals.resize(heights.size());
+			normals = result.normals.data();
+		}
+
+		PROFILE_COUNT("noise samples", heights.size() * sampler.octaves());
+		workers.parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+			if (cancel.cancelled()) {
+				return;
 			}
+			std::vector<float> slopeX(gridSize);
+			std::vector<float> slopeZ(gridSize);
+			for (int row = rowBegin; row < rowEnd; row++) {
+				sampler.sampleRowGradient(row, 0, gridSize, &heights[row * gridSize], slopeX.data(), slopeZ.data());
+
+				// Same orientation as the face normals, towards -y
+				glm::vec3* out = normals + row * gridSize;
+				for (int col = 0; col < gridSize; col++) {
+					out[col] = slopeNormal(slopeX[col], slopeZ[col]);
+				}
+			}
+		});
+		if (result.target.normals && normals != result.target.normals && !cancel.cancelled()) {
+			std::copy(result.normals.begin(), result.normals.end(), result.target.normals);
+		}
+		return;
+	}
+
+	noiseCache.setBudget((size_t)std::max(cfg.noiseCacheMB, 0) * 1024 * 1024);
+	if (noiseCache.heights(sampler, cfg, workers, heights.data(), cancel)) {
+		PROFILE_COUNT("noise samples", heights.size() * noiseCache.getComputed());
+		std::cout << "Noise layers: " << noiseCache.getReused() << " cached, "
+			<< noiseCache.getComputed() << " computed\n";
+		return;
+	}
+
+	// Every height only depends on its own row and column, so the rows are
+	// split into bands and generated in parallel
+	PROFILE_COUNT("noise samples", heights.size() * sampler.octaves());
+	workers.parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+		if (cancel.cancelled()) {
+			return;
+		}
+		for (int row = rowBegin; row < rowEnd; row++) {
+			sampler.sampleRow(row, 0, gridSize, &heights[row * gridSize]);
+		}
+	});
+}
 
-			float finalHeight = h * falloff * 15.0f;
+bool mountain::loadStoredHeights(TerrainBuild& result)
+{
+	PROFILE_ZONE("tile store load");
+	const config& cfg = result.cfg;
+	TileData tile;
+	if (!tileStore.open(TileStore::pathFor(cfg), cfg) || !tileStore.find(0, 0, tile)) {
+		return false;
+	}
 
-			verts[index].x = posX;
-			if (finalHeight < 0) verts[index].y = -finalHeight;
-			if (finalHeight >= 0) verts[index].y = finalHeight;
-			verts[index].z = posZ;
+	// Stored normals are only used when they were made the same way.
+	// Analytic ones can't be redone from the heights alone.
+	bool needsNormals = cfg.vertexFormat < 2;
+	bool normalsMatch = tile.normals && tileStore.normalMode() == cfg.normalMode;
+	if (needsNormals && cfg.normalMode == 3 && !normalsMatch) {
+		return false;
+	}
 
-			// Simple UV mapping [0..1]
-			texcoords[index] = glm::vec2(
-				col / (float)subdivisions,
-				row / (float)subdivisions
-			);
+	// Pages of the mapping are read in as they are copied
+	size_t count = (size_t)(cfg.subdivisions + 1) * (cfg.subdivisions + 1);
+	result.heights.assign(tile.heights, tile.heights + count);
+	if (needsNormals && normalsMatch) {
+		glm::vec3* normals = result.target.normals;
+		if (!normals) {
+			result.normals.resize(count);
+			normals = result.normals.data();
 		}
+		std::copy(tile.normals, tile.normals + count, normals);
+		result.normalsLoaded = true;
 	}
+	result.fromStore = true;
+	return true;
+}
 
-	//time after first loop
-	auto afterFirstLoop = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double> elapsedFirstLoop = afterFirstLoop - start;
-	std::cout << "First loop time: " << elapsedFirstLoop.count() << " s\n";
+void mountain::storeHeights(const TerrainBuild& result)
+{
+	PROFILE_ZONE("tile store save");
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Normals only when they are in memory, mapped buffers aren't read back.
+	// Analytic normals are always kept in memory with the store on, they
+	// can't be redone from the stored heights.
+	TileData tile;
+	tile.heights = result.heights.data();
+	tile.normals = result.normals.empty() ? nullptr : result.normals.data();
+	tile.bounds = glm::vec2(result.heightRange.x, result.heightRange.x + result.heightRange.y);
+
+	const config& cfg = result.cfg;
+	if (!tileStore.save(TileStore::pathFor(cfg), cfg, { tile })) {
+		return;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> elapsed = end - start;
+	std::cout << "Tile store time: " << elapsed.count() << " s\n";
+}
+
+std::shared_ptr<const TerrainGrid> mountain::generateGrid(const config& cfg)
+{
+	PROFILE_ZONE("grid");
+	ThreadPool& workers = threadPool();
+	int subdivisions = cfg.subdivisions;
+	int gridSize = subdivisions + 1;
+
+	auto result = std::make_shared<TerrainGrid>();
+	result->subdivisions = subdivisions;
+	result->vertexFormat = cfg.vertexFormat;
+
+	// The CDLOD and tessellation patches bring their own indices
+	if (cfg.vertexFormat >= 3) {
+		return result;
+	}
 
 	// Generate indices for a standard grid of triangles
-	std::vector<unsigned int> indices;
-	indices.reserve(subdivisions * subdivisions * 6);
+	std::vector<unsigned int>& indices = result->indices;
+	indices.resize(subdivisions * subdivisions * 6);
+
+	gridIndices(workers, subdivisions, indices.data());
 
-	for (int row = 0; row < subdivisions; row++) {
-		for (int col = 0; col < subdivisions; col++) {
-			int i0 = row * (subdivisions + 1) + col;
-			int i1 = row * (subdivisions + 1) + (col + 1);
-			int i2 = (row + 1) * (subdivisions + 1) + col;
-			int i3 = (row + 1) * (subdivisions + 1) + (col + 1);
+	// Only the float streams carry texture coordinates, the other formats
+	// rebuild them from the vertex index
+	if (cfg.vertexFormat != 0) {
+		return result;
+	}
 
-			// Two triangles per quad
-			// Triangle 1
-			indices.push_back(i0);
-			indices.push_back(i1);
-			indices.push_back(i2);
+	std::vector<glm::vec2>& texcoords = result->texCoords;
+	texcoords.resize(gridSize * gridSize);
+	workers.parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+		for (int row = rowBegin; row < rowEnd; row++) {
+			for (int col = 0; col < gridSize; col++) {
+				// Simple UV mapping [0..1]
+				texcoords[row * gridSize + col] = glm::vec2(
+					col / (float)subdivisions,
+					row / (float)subdivisions
+				);
+			}
+		}
+	});
+	return result;
+}
 
-			// Triangle 2
-			indices.push_back(i1);
-			indices.push_back(i3);
-			indices.push_back(i2);
+void mountain::buildVertices(TerrainBuild& result)
+{
+	PROFILE_ZONE("vertices");
+	HeightfieldSampler sampler(result.cfg);
+	ThreadPool& workers = threadPool();
+	int gridSize = result.cfg.subdivisions + 1;
+	const std::vector<float>& heights = result.heights;
+
+	// Straight into the mapped float streams when there are some, the
+	// packed format still needs full precision normals to pack from.
+	// Analytic and stored normals were already written along with the
+	// heights.
+	bool analytic = result.cfg.normalMode == 3 || result.normalsLoaded;
+	bool mapped = result.target.verts && result.target.normals;
+	// Positions are only needed in a vertex buffer, the packed format
+	// rebuilds them in the shader
+	bool writesPositions = mapped || result.cfg.vertexFormat == 0;
+	glm::vec3* verts = nullptr;
+	glm::vec3* normals = nullptr;
+	if (mapped) {
+		verts = result.target.verts;
+		normals = result.target.normals;
+	}
+	else {
+		if (writesPositions) {
+			result.verts.resize(heights.size());
+			verts = result.verts.data();
+		}
+		if (!analytic) {
+			result.normals.resize(heights.size());
+			normals = result.normals.data();
 		}
 	}
 
-	//time after second loop
-	auto afterSecondLoop = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double> elapsedSecondLoop = afterSecondLoop - afterFirstLoop;
-	std::cout << "Second loop time: " << elapsedSecondLoop.count() << " s\n";
+	auto position = [&](int index) {
+		return glm::vec3(sampler.gridX(index % gridSize), heights[index], sampler.gridZ(index / gridSize));
+	};
+
+	if (writesPositions) {
+		workers.parallelFor(0, gridSize, [&](int rowBegin, int rowEnd) {
+			for (int row = rowBegin; row < rowEnd; row++) {
+				float posZ = sampler.gridZ(row);
+				for (int col = 0; col < gridSize; col++) {
+					// Index of the current vertex in the array
+					int index = row * gridSize + col;
+					verts[index] = glm::vec3(sampler.gridX(col), heights[index], posZ);
+				}
+			}
+		});
+	}
 
-	// Compute normals for the entire mesh
-	computeNormals(indices, normals, verts);
-	std::vector<glm::vec3> finalVerts;
-	std::vector<glm::vec3> finalNormals;
-	std::vector<glm::vec2> finalTexcoords;
-	finalVerts.resize(indices.size());
-	finalNormals.resize(indices.size());
-	finalTexcoords.resize(indices.size());
+	if (result.normalsLoaded) {
+		return;
+	}
 
-	for (int i = 0; i < indices.size(); i++) {
-		finalVerts[i] = verts[indices[i]];
-		finalNormals[i] = normals[indices[i]];
-		finalTexcoords[i] = texcoords[indices[i]];
+	// Compute normals for the entire mesh, from the heights so that mapped
+	// memory is never read back
+	switch (result.cfg.normalMode) {
+	case 3:
+		break;
+	case 0: {
+		// Reference scatter over the triangles, needs every position in
+		// memory. mapTarget() never maps for this mode.
+		std::vector<glm::vec3> positions;
+		if (result.verts.empty()) {
+			positions.resize(heights.size());
+			for (size_t i = 0; i < positions.size(); i++) {
+				positions[i] = position((int)i);
+			}
+		}
+		computeNormals(result.grid->indices, result.normals, result.verts.empty() ? positions : result.verts);
+		break;
 	}
+	case 2:
+		centralDifferenceNormals(workers, result.cfg.subdivisions,
+			result.cfg.width / (float)result.cfg.subdivisions, result.cfg.height / (float)result.cfg.subdivisions,
+			heights.data(), normals);
+		break;
+	default:
+		gridNormals(workers, result.cfg.subdivisions, normals, position);
+		break;
+	}
+}
 
-	//third loop time
-	auto thirdLoop = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double> elapsedThirdLoop = thirdLoop - afterSecondLoop;
-	std::cout << "Third loop time: " << elapsedThirdLoop.count() << " s\n";
+void mountain::computeBounds(TerrainBuild& result)
+{
+	PROFILE_ZONE("bounds");
+	// Min and max height of every chunk for culling and for the CDLOD
+	// nodes. The root bounds give the height range for the unorm16 heights
+	// of the packed format.
+	result.lodTree = buildLODTree(result.cfg.subdivisions, result.heights, threadPool());
+
+	const TerrainLODTree& tree = *result.lodTree;
+	glm::vec2 bounds = tree.nodeBounds(tree.levels - 1, 0, 0);
+	result.heightRange = glm::vec2(bounds.x, bounds.y - bounds.x);
+}
 
-	m_cpu_geom.verts = finalVerts;
-	m_cpu_geom.normals = finalNormals;
+void mountain::packVertices(TerrainBuild& result)
+{
+	PROFILE_ZONE("pack vertices");
+	// x, z and texcoords come from the vertex index in test.vert
+	PackedTerrainVertex* packed = result.target.packed;
+	if (!packed) {
+		result.packed.resize(result.heights.size());
+		packed = result.packed.data();
+	}
 
-	//m_gpu_geom.bind();
-	m_gpu_geom.setVerts(m_cpu_geom.verts);
-	m_gpu_geom.setNormals(m_cpu_geom.normals);
+	threadPool().parallelFor(0, (int)result.heights.size(), [&](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			packed[i] = packTerrainVertex(result.heights[i], result.heightRange.x, result.heightRange.y, result.normals[i]);
+		}
+	}, 4096);
 
-	//time after fourth loop
-	auto fourthLoop = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double> elapsedFourthLoop = fourthLoop - thirdLoop;
-	std::cout << "Fourth loop time: " << elapsedFourthLoop.count() << " s\n";
+	// The normals were only needed for packing
+	if (!result.cfg.keepCpuGeometry) {
+		result.normals.clear();
+		result.normals.shrink_to_fit();
+	}
+}
 
-	m_gpu_geom.setTexCoords(finalTexcoords);
+void mountain::present(std::unique_ptr<TerrainBuild> result)
+{
+	PROFILE_ZONE("present");
+	if (!result) {
+		return;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
 
-	//size
-	m_size = m_cpu_geom.verts.size();
+	// Upload into the slot that isn't on screen, then flip
+	TerrainSlot& slot = slots[1 - front];
+	upload(slot, *result);
+	front = 1 - front;
 
- 	//end time
+	// Render settings may have moved on while the build ran
+	config shown = result->cfg;
+	if (hasRequest) {
+		copyRenderSettings(shown, requested);
+	}
+	_config = shown;
+
+	heightRange = result->heightRange;
+	m_size = (GLsizei)result->grid->indices.size();
+	m_vertexCount = (GLsizei)((result->cfg.subdivisions + 1) * (result->cfg.subdivisions + 1));
+
+	m_heights = std::move(result->heights);
+	if (result->cfg.keepCpuGeometry) {
+		m_cpu_geom.verts = std::move(result->verts);
+		m_cpu_geom.normals = std::move(result->normals);
+		if (cpuGrid != result->grid) {
+			m_cpu_geom.indices = result->grid->indices;
+			m_cpu_geom.texCoords = result->grid->texCoords;
+			cpuGrid = result->grid;
+		}
+	}
+	else {
+		m_cpu_geom = CPU_Geometry();
+		cpuGrid.reset();
+	}
+
+	//time after the upload
 	auto end = std::chrono::high_resolution_clock::now();
-	std::chrono::duration<double> elapsed = end - start;
-	std::cout << "Normal time: " << elapsed.count() << " s\n";
+	std::chrono::duration<double> elapsedFourthLoop = end - start;
+	std::cout << "Present time: " << elapsedFourthLoop.count() << " s\n";
+	lastTimings = result->timings;
+	lastTimings.present = elapsedFourthLoop.count();
+}
+
+void mountain::upload(TerrainSlot& slot, const TerrainBuild& result)
+{
+	PROFILE_ZONE("upload");
+	const config& cfg = result.cfg;
+
+	// A slot that already holds this grid and layout keeps its index
+	// buffer, texcoords and VAO setup, only the height data is replaced
+	bool gridChanged = slot.grid != result.grid;
+	bool layoutChanged = slot.vertexFormat != cfg.vertexFormat;
+
+	// A zero-copy or compute build already wrote its vertices into this
+	// slot. Any other mapping is stale and has to go before the buffers are
+	// uploaded to.
+	bool zeroCopy = !result.target.empty() || result.onGpu;
+	if (!slot.geom.unmapVertices() && zeroCopy) {
+		std::cerr << "Error: terrain vertex buffers were lost while mapped, they stay invalid until the next regen\n";
+	}
+	slot.mapped = TerrainTarget();
+
+	//slot.geom.bind();
+	if (cfg.vertexFormat >= 2) {
+		// One texel per grid vertex, nothing else changes between regens
+		// of the same size
+		if (!result.onGpu) {
+			slot.heightTexture.upload(cfg.subdivisions + 1, result.heights.data());
+		}
+		if (layoutChanged) {
+			slot.geom.setupAttributeless();
+		}
+	}
+	else if (cfg.vertexFormat == 1) {
+		if (!zeroCopy) {
+			slot.geom.setPackedVerts(result.packed);
+			PROFILE_COUNT("bytes uploaded", result.packed.size() * sizeof(PackedTerrainVertex));
+		}
+		if (layoutChanged) {
+			slot.geom.setupPacked(3, 4);
+		}
+	}
+	else {
+		if (!zeroCopy) {
+			slot.geom.setVerts(result.verts);
+			slot.geom.setNormals(result.normals);
+			PROFILE_COUNT("bytes uploaded", (result.verts.size() + result.normals.size()) * sizeof(glm::vec3));
+		}
+		if (gridChanged) {
+			slot.geom.setTexCoords(result.grid->texCoords);
+		}
+		if (layoutChanged) {
+			slot.geom.setup(0, 1, 2);
+		}
+	}
+
+	// The grid goes up once as unique vertices, triangles share them
+	// through the index buffer
+	if (gridChanged) {
+		size_t gridSize = (size_t)cfg.subdivisions + 1;
+		slot.geom.setIndices(result.grid->indices, gridSize * gridSize);
+		PROFILE_COUNT("bytes uploaded", result.grid->indices.size() * sizeof(unsigned int));
+	}
+
+	slot.grid = result.grid;
+	slot.lodTree = result.lodTree;
+	slot.vertexFormat = cfg.vertexFormat;
+}
+
+void mountain::draw()
+{
+	PROFILE_ZONE("draw terrain");
+	GLenum mode = (_config.type == 0) ? GL_POINTS : GL_TRIANGLES;
+	if (_config.world) {
+		GLint program = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		tileWorld.update(_config, viewPosition);
+		tileWorld.draw((GLuint)program, mode, viewFrustum);
+		return;
+	}
+
+	TerrainSlot& slot = slots[front];
+	if (!slot.grid) {
+		// Nothing built yet
+		return;
+	}
+
+	if (_config.vertexFormat >= 2) {
+		slot.heightTexture.bind(1);
+	}
+	if (usesTessellation()) {
+		GLint program = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		tessellation.draw((GLuint)program, _config, viewPosition, viewProjectionScale);
+	}
+	else if (_config.vertexFormat >= 3) {
+		// Patches around the camera instead of the whole grid
+		GLint program = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+		lod.select(*slot.lodTree, _config, viewPosition, viewProjectionScale, viewFrustum);
+		lod.draw((GLuint)program, mode);
+	}
+	else if (hasView) {
+		// Only the chunks that can be on screen
+		chunks.cull(*slot.lodTree, glm::vec2(_config.width, _config.height), viewFrustum);
+		chunks.draw(slot.geom, mode);
+	}
+	else if (_config.type == 0) {
+		// Every grid vertex once
+		slot.geom.bind();
+		glDrawArrays(GL_POINTS, 0, m_vertexCount);
+		DrawStats::count(GL_POINTS, m_vertexCount);
+	}
+	else if (_config.type == 1) {
+		slot.geom.drawElements(GL_TRIANGLES);
+	}
+
+	// Waited on before the slot's buffers are mapped unsynchronized again
+	slot.lastDraw.place();
+}
+
+void mountain::setView(glm::vec3 cameraPos, const glm::mat4& viewProjection, float projectionScale)
+{
+	hasView = true;
+	viewPosition = cameraPos;
+	viewFrustum = Frustum(viewProjection);
+	viewProjectionScale = projectionScale;
+}
+
+void mountain::enableTessellation(bool enabled)
+{
+	tessellationEnabled = enabled;
+}
+
+bool mountain::usesTessellation() const
+{
+	// Points stay on the CDLOD path, world tiles on the static grids
+	return tessellationEnabled && _config.vertexFormat == 4 && _config.type == 1 && !_config.world;
+}
+
+void mountain::recompileComputeShaders()
+{
+	if (compute.recompile() && !_config.world && _config.generator == 1) {
+		rebuild(_config);
+	}
+}
+
+void mountain::setShaderUniforms(GLuint program) const
+{
+	// vertexFormat 4 without tessellation has test.vert draw the same
+	// heights as CDLOD patches. World tiles are height textures on a static
+	// grid, TileWorld sets gridSize per tile.
+	int vertexFormat = _config.world ? 2 : std::min(_config.vertexFormat, 3);
+	glUniform1i(glGetUniformLocation(program, "vertexFormat"), vertexFormat);
+	glUniform1i(glGetUniformLocation(program, "gridSize"), _config.subdivisions + 1);
+	glUniform2f(glGetUniformLocation(program, "terrainSize"), (float)_config.width, (float)_config.height);
+	glUniform2f(glGetUniformLocation(program, "heightRange"), heightRange.x, heightRange.y);
+	glUniform1i(glGetUniformLocation(program, "heightMap"), 1);
+}
+
+size_t mountain::cpuBytes() const
+{
+	// What is on screen only, the caches and grid belong to the building
+	// thread
+	return m_cpu_geom.bytes() + m_heights.capacity() * sizeof(float);
+}
+
+size_t mountain::gpuBytes() const
+{
+	size_t bytes = texture.bytes() + tileWorld.getMemoryBytes();
+	for (const TerrainSlot& slot : slots) {
+		bytes += slot.geom.bytes() + slot.heightTexture.bytes();
+	}
+	return bytes;
+}
+
+bool mountain::applyRenderOnly(const config& _newConfig)
+{
+	// Nothing has been requested yet, so everything is stale
+	ConfigChange change = hasRequest
+		? classifyChange(requested, _newConfig)
+		: ConfigChange::Topology;
+	requested = _newConfig;
+	hasRequest = true;
+
+	switch (change) {
+	case ConfigChange::None:
+		std::cout << "Config unchanged, terrain kept\n";
+		return true;
+	case ConfigChange::Render:
+		// draw() and the render loop read these every frame
+		copyRenderSettings(_config, _newConfig);
+		std::cout << "Render settings changed, terrain kept\n";
+		return true;
+	case ConfigChange::Height:
+		std::cout << "Height settings changed, reusing the grid\n";
+		return false;
+	case ConfigChange::Topology:
+		return false;
+	}
+	return false;
 }
 
 void mountain::updateConfig(config _newConfig)
 {
-	this->_config = _newConfig;
-	elevate();
+	if (applyRenderOnly(_newConfig)) {
+		return;
+	}
+
+	rebuild(_newConfig);
+}
+
+void mountain::requestConfig(config _newConfig)
+{
+	if (applyRenderOnly(_newConfig)) {
+		return;
+	}
+
+	// Compute builds have to run on the GL thread and take a fraction of a
+	// CPU build, so they don't go through the worker. Tiled worlds have
+	// workers of their own.
+	if (_newConfig.world || generatesOnGpu(_newConfig)) {
+		rebuild(_newConfig);
+		return;
+	}
+
+	if (!worker) {
+		worker = std::make_unique<RegenWorker>(
+			[this](const config& cfg, const TerrainTarget& target, const CancelToken& cancel) {
+				return build(cfg, target, cancel);
+			});
+	}
+
+	// A running build may be writing into the back slot's mapping, which can
+	// be handed on but not replaced. Without a mapping the build goes through
+	// vectors and the usual upload. The render loop never waits on the GPU.
+	TerrainSlot& back = slots[1 - front];
+	TerrainTarget target;
+	if (back.mapped.fits(_newConfig) || !worker->busy()) {
+		target = mapTarget(back, _newConfig, 0);
+	}
+	worker->request(_newConfig, target);
+}
+
+void mountain::pollRegeneration()
+{
+	if (worker) {
+		present(worker->takeFinished());
+	}
+}
+
+bool mountain::isRegenerating()
+{
+	return worker && worker->busy();
+}
+
+TerrainTarget mountain::mapTarget(TerrainSlot& slot, const config& cfg, GLuint64 timeout)
+{
+	// A CPU copy and the reference normals have to be built in vectors
+	// anyway, and the height texture formats have no vertex buffers to fill
+	if (cfg.keepCpuGeometry || cfg.vertexFormat >= 2 || cfg.normalMode == 0) {
+		return TerrainTarget();
+	}
+	if (slot.mapped.fits(cfg)) {
+		return slot.mapped;
+	}
+
+	slot.geom.unmapVertices();
+	slot.mapped = TerrainTarget();
+
+	// The slot is off screen, but the GPU may still be working through the
+	// last frames that drew it
+	if (!slot.lastDraw.wait(timeout)) {
+		return TerrainTarget();
+	}
+
+	TerrainTarget target;
+	target.vertexFormat = cfg.vertexFormat;
+	target.vertexCount = (size_t)(cfg.subdivisions + 1) * (cfg.subdivisions + 1);
+
+	bool mapped;
+	if (cfg.vertexFormat == 1) {
+		target.packed = slot.geom.mapPackedVerts(target.vertexCount);
+		mapped = target.packed != nullptr;
+	}
+	else {
+		target.verts = slot.geom.mapVerts(target.vertexCount);
+		target.normals = slot.geom.mapNormals(target.vertexCount);
+		mapped = target.verts != nullptr && target.normals != nullptr;
+	}
+
+	if (!mapped) {
+		slot.geom.unmapVertices();
+		return TerrainTarget();
+	}
+	slot.mapped = target;
+	return target;
 }
@@ -3,9 +3,24 @@
 #include "Geometry.h"
 #include <glm/gtx/transform.hpp>
 #include "Texture.h"
+#include "HeightTexture.h"
 #include "config.h"
 #include "Vertex.h"
 #include "SimplexNoise.h"
+#include "Heightfield.h"
+#include "NoiseLayerCache.h"
+#include "RegenWorker.h"
+#include "TerrainBuild.h"
+#include "TerrainChunks.h"
+#include "TerrainCompute.h"
+#include "TerrainLOD.h"
+#include "TerrainTessellation.h"
+#include "TileStore.h"
+#include "TileWorld.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+#include <memory>
 
 
 class mountain {
@@ -16,19 +31,69 @@ public:
 		//elevate();
 	}
 	CPU_Geometry m_cpu_geom;    // We dont really need atm
-	GPU_Geometry m_gpu_geom;
+	std::vector<float> m_heights; // (subdivisions+1)^2 grid heights, row by row
 	glm::mat4 m_model;
-	GLsizei m_size;
+	GLsizei m_size;        // number of indices
+	GLsizei m_vertexCount; // number of unique grid vertices
 
 	float ridge(float h, float offset);
-	float ridgedMF(float x, float y, SimplexNoise noise);
+	// Per-sample reference path, elevate() goes through HeightfieldSampler
+	float ridgedMF(float x, float y, const SimplexNoise& noise);
 	float getDistance(float x1, float y1, float x2, float y2);
 	void computeNormals(
 		const std::vector<unsigned int>& indices,
 		std::vector<glm::vec3>& normals,
 		std::vector<glm::vec3>& verts);
+	// Same result as computeNormals() for the grid built in elevate(), but
+	// gathers the faces around each vertex so rows can be split across threads
+	void computeGridNormals(
+		int subdivisions,
+		std::vector<glm::vec3>& normals,
+		const std::vector<glm::vec3>& verts);
+	// Cheaper approximation from central differences of the grid heights,
+	// spacing is the world distance between columns and rows
+	void computeHeightNormals(
+		int subdivisions,
+		glm::vec2 spacing,
+		const std::vector<float>& heights,
+		std::vector<glm::vec3>& normals);
+	// Full rebuild of the current config, blocks until it is on the GPU
 	void elevate();
+	// Diffs against the last requested config and regenerates as little as
+	// possible before returning
 	void updateConfig(config config);
+	// Same diffing, but the regen runs on a background thread while the
+	// current terrain keeps being drawn. Newer requests cancel older ones.
+	void requestConfig(config config);
+	// Swaps in a finished background regen, call once per frame before
+	// drawing. Never waits for a running one.
+	void pollRegeneration();
+	bool isRegenerating();
+	// Camera to cull chunks against, pick the CDLOD patches of vertexFormat
+	// 3 for and stream world tiles around. cameraPos and viewProjection are in terrain space,
+	// projectionScale is the viewport height over 2 tan(fovy / 2). Set
+	// before draw(), without a view everything is drawn.
+	void setView(glm::vec3 cameraPos, const glm::mat4& viewProjection, float projectionScale);
+	// Set once the tessellation program linked. Without it vertexFormat 4
+	// draws like vertexFormat 3.
+	void enableTessellation(bool enabled);
+	// Whether draw() needs the tessellation program bound instead of test.vert
+	bool usesTessellation() const;
+	// Points (type 0) or indexed triangles (type 1), the caller binds the
+	// shader and textures
+	void draw();
+	// Rebuilds the compute generator from its shader files and regenerates
+	// the terrain on screen when it came from there. GL thread only.
+	void recompileComputeShaders();
+	// Grid layout and height range test.vert needs to decode packed vertices
+	void setShaderUniforms(GLuint program) const;
+
+	// Stage timings of the build on screen
+	const TerrainTimings& getLastTimings() const { return lastTimings; }
+	// Memory held by the terrain geometry, heights and textures
+	size_t cpuBytes() const;
+	size_t gpuBytes() const;
+	size_t getTileCount() const { return tileWorld.getTileCount(); }
 
 	std::string name;
 
@@ -39,6 +104,95 @@ public:
 	
 
 private:
+	// GPU copy of one build. Two of them so a new build can be uploaded while
+	// the other one is on screen.
+	struct TerrainSlot {
+		GPU_Geometry geom;
+		HeightTexture heightTexture;               // vertexFormats 2 to 4
+		std::shared_ptr<const TerrainLODTree> lodTree; // chunk and node bounds
+		std::shared_ptr<const TerrainGrid> grid;   // grid in the index buffer
+		int vertexFormat = -1;                     // layout the VAO is set up for
+		TerrainTarget mapped;                      // vertex buffers currently mapped
+		SyncHandle lastDraw;                       // fence after the last draw from it
+	};
 
-};
+	// How long a blocking regen waits for the GPU to release a slot before
+	// falling back to a regular upload, in nanoseconds
+	static constexpr GLuint64 MapWaitTimeout = 1000000000;
+
+	// Minimum height and max - min of the current mesh
+	glm::vec2 heightRange;
+	TerrainTimings lastTimings;
+
+	TerrainSlot slots[2];
+	int front = 0;
+
+	// Visible chunks and patches, shared by both slots and redone every frame
+	TerrainChunks chunks;
+	TerrainLOD lod;
+	TerrainTessellation tessellation;
+	bool tessellationEnabled = false;
+
+	// Compute shader generator for config generator 1
+	TerrainCompute compute;
+
+	// Tiles around the camera for config world 1, drawn instead of the slots
+	TileWorld tileWorld;
+	bool hasView = false;
+	glm::vec3 viewPosition = glm::vec3(0.0f);
+	Frustum viewFrustum;
+	float viewProjectionScale = 1.0f;
 
+	// Newest config passed to updateConfig()/requestConfig(), _config is the
+	// one on screen
+	config requested;
+	bool hasRequest = false;
+
+	// Owned by whichever thread is building, builds never overlap
+	std::unique_ptr<ThreadPool> pool;
+	int poolThreads = -1;
+	NoiseLayerCache noiseCache;                 // raw octave noise kept across gain/ridgeOffset/octave edits
+	std::shared_ptr<const TerrainGrid> grid;    // grid of the last build
+	std::shared_ptr<const TerrainGrid> cpuGrid; // grid copied into m_cpu_geom
+	TileStore tileStore;                        // heights of config tileStore 1, tile (0, 0)
+
+	ThreadPool& threadPool();
+	ThreadPool& threadPool(int threads);
+
+	// Stages of a build, none of them touch GL
+	std::unique_ptr<TerrainBuild> build(const config& cfg, const TerrainTarget& target, const CancelToken& cancel);
+	void generateHeights(TerrainBuild& result, const CancelToken& cancel);
+	std::shared_ptr<const TerrainGrid> generateGrid(const config& cfg); // indices and texcoords
+	void buildVertices(TerrainBuild& result);      // positions and normals from the heights
+	void computeBounds(TerrainBuild& result);      // height range and chunk bounds
+	void packVertices(TerrainBuild& result);       // vertexFormat 1
+	// Heights, and normals when they fit, from the tile store instead of
+	// the noise. False when the store has nothing usable for the build.
+	bool loadStoredHeights(TerrainBuild& result);
+	void storeHeights(const TerrainBuild& result);
+
+	// Blocking regen of cfg on this thread, on the GPU when cfg asks for it
+	// and it can be done there. Tiled worlds generate in draw() instead.
+	void rebuild(const config& cfg);
+	bool generatesOnGpu(const config& cfg);
+	// Generates cfg with the compute shaders into the back slot, needs the
+	// GL thread
+	std::unique_ptr<TerrainBuild> buildOnGpu(const config& cfg);
+	// Compares the heights of a GPU build against HeightfieldSampler
+	void validateGpuHeights(const TerrainBuild& result);
+
+	// Maps the slot's vertex buffers for a zero-copy build of cfg, reusing a
+	// fitting mapping. Empty when the build should use vectors instead.
+	TerrainTarget mapTarget(TerrainSlot& slot, const config& cfg, GLuint64 timeout);
+
+	// Uploads a build into the back slot and makes it the front one
+	void present(std::unique_ptr<TerrainBuild> result);
+	void upload(TerrainSlot& slot, const TerrainBuild& result);
+
+	// Takes over the render settings and returns true when nothing else
+	// changed since the last request
+	bool applyRenderOnly(const config& config);
+
+	// Declared last so its thread stops before the state it builds with goes
+	std::unique_ptr<RegenWorker> worker;
+};
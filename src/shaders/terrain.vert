@@ -0,0 +1,17 @@
+#version 400 core
+// Corners of the coarse patch grid for the tessellation path (vertexFormat 4).
+// No attributes, four vertices per patch come from gl_VertexID.
+
+uniform int gridSize;        // vertices per side of the height grid
+uniform int patchesPerSide;
+
+out vec2 vGridPos; // corner position in grid cells
+
+void main()
+{
+    int patchIndex = gl_VertexID / 4;
+    int corner = gl_VertexID % 4;
+
+    ivec2 cell = ivec2(patchIndex % patchesPerSide, patchIndex / patchesPerSide) + ivec2(corner & 1, corner >> 1);
+    vGridPos = vec2(cell) * (float(gridSize - 1) / float(patchesPerSide));
+}
@@ -3,6 +3,10 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord; // Texture coordinates input
 
+// Packed terrain vertices (vertexFormat 1), see PackedTerrainVertex
+layout (location = 3) in float aHeight;    // unorm16 height in [0, 1]
+layout (location = 4) in vec2 aOctNormal;  // octahedral normal in [-1, 1]
+
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoord; // Pass texture coordinates to the fragment shader
@@ -11,10 +15,131 @@ uniform mat4 M;
 uniform mat4 V;
 uniform mat4 P;
 
+uniform int vertexFormat;  // 0 = float streams, 1 = packed grid vertices, 2 = height texture, 3 = CDLOD patches
+                           // (vertexFormat 4 goes through terrain.tesc/.tese)
+uniform int gridSize;      // vertices per side of the grid
+uniform vec2 terrainSize;  // width and height in world units
+uniform vec2 heightRange;  // minimum height, max - min
+uniform sampler2D heightMap; // R32F grid heights (vertexFormats 2 and 3)
+uniform vec2 tileOffset;   // world x and z of the current tile's centre, see TileWorld
+uniform int apron;         // texels around the grid in heightMap, 1 for TileWorld tiles
+
+// Current CDLOD patch (vertexFormat 3), see TerrainLOD
+uniform int patchSize;     // quads per patch side
+uniform vec2 nodeOrigin;   // grid cell of the node corner
+uniform float nodeSize;    // grid cells per node side
+uniform vec2 nodeMorph;    // distance where the morph starts, 1 / morph distance
+uniform vec3 lodCamera;    // camera position the nodes were picked for
+
+// Inverse of encodeOctahedral() in Vertex.h, folded around y
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+    if (n.y < 0.0) {
+        vec2 folded = (1.0 - abs(n.zx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.z >= 0.0 ? 1.0 : -1.0);
+        n.x = folded.x;
+        n.z = folded.y;
+    }
+    return normalize(n);
+}
+
+// Height of grid vertex (col, row), clamped to the grid and its apron
+float gridHeight(ivec2 cell)
+{
+    return texelFetch(heightMap, clamp(cell, ivec2(-apron), ivec2(gridSize - 1 + apron)) + apron, 0).r;
+}
+
+// Bilinear height at a fractional grid position
+float sampleHeight(vec2 gridPos)
+{
+    return texture(heightMap, (gridPos + 0.5) / float(gridSize)).r;
+}
+
+vec3 terrainPosition(vec2 gridPos)
+{
+    vec2 uv = gridPos / float(gridSize - 1);
+    return vec3(
+        uv.x * terrainSize.x - terrainSize.x / 2.0,
+        sampleHeight(gridPos),
+        uv.y * terrainSize.y - terrainSize.y / 2.0
+    );
+}
+
 void main()
 {
-    FragPos = vec3(M * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(M))) * aNormal; // Transform normals
-    TexCoord = aTexCoord; // Pass texture coordinates
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    vec2 texCoord = aTexCoord;
+
+    if (vertexFormat == 1) {
+        // x, z and the texture coordinates follow from the grid index
+        int col = gl_VertexID % gridSize;
+        int row = gl_VertexID / gridSize;
+        vec2 cell = vec2(col, row) / float(gridSize - 1);
+
+        position = vec3(
+            cell.x * terrainSize.x - terrainSize.x / 2.0,
+            heightRange.x + aHeight * heightRange.y,
+            cell.y * terrainSize.y - terrainSize.y / 2.0
+        );
+        normal = decodeOctahedral(aOctNormal);
+        texCoord = cell;
+    }
+    else if (vertexFormat == 2) {
+        // Only the heights live on the GPU, the grid and the normals are
+        // rebuilt from the vertex index and the neighbouring texels
+        ivec2 cell = ivec2(gl_VertexID % gridSize, gl_VertexID / gridSize);
+        vec2 uv = vec2(cell) / float(gridSize - 1);
+        vec2 spacing = terrainSize / float(gridSize - 1);
+
+        position = vec3(
+            uv.x * terrainSize.x - terrainSize.x / 2.0,
+            gridHeight(cell),
+            uv.y * terrainSize.y - terrainSize.y / 2.0
+        );
+
+        // Central differences, one-sided on the border unless the apron
+        // has the neighbouring heights
+        ivec2 left = max(cell - ivec2(1, 0), ivec2(-apron));
+        ivec2 right = min(cell + ivec2(1, 0), ivec2(gridSize - 1 + apron));
+        ivec2 up = max(cell - ivec2(0, 1), ivec2(-apron));
+        ivec2 down = min(cell + ivec2(0, 1), ivec2(gridSize - 1 + apron));
+
+        float dx = (gridHeight(right) - gridHeight(left)) / (float(right.x - left.x) * spacing.x);
+        float dz = (gridHeight(down) - gridHeight(up)) / (float(down.y - up.y) * spacing.y);
+        // Same orientation as the CPU grid normals
+        normal = normalize(vec3(dx, -1.0, dz));
+        texCoord = uv;
+    }
+    else if (vertexFormat == 3) {
+        // Patch vertex from the index, scaled to the node
+        vec2 local = vec2(gl_VertexID % (patchSize + 1), gl_VertexID / (patchSize + 1));
+        float step = nodeSize / float(patchSize);
+        float lastCell = float(gridSize - 1);
+
+        // Towards the end of its range every odd vertex collapses onto its
+        // lower even neighbour, which straightens the edge to match the
+        // next coarser level
+        vec3 unmorphed = terrainPosition(min(nodeOrigin + local * step, vec2(lastCell)));
+        float morph = clamp((distance(unmorphed, lodCamera) - nodeMorph.x) * nodeMorph.y, 0.0, 1.0);
+        local -= fract(local * 0.5) * 2.0 * morph;
+
+        // Nodes overhanging the border fold onto it
+        vec2 gridPos = min(nodeOrigin + local * step, vec2(lastCell));
+        position = terrainPosition(gridPos);
+
+        // Central differences at the node's vertex spacing
+        vec2 spacing = terrainSize / lastCell * step;
+        float dx = (sampleHeight(gridPos + vec2(step, 0.0)) - sampleHeight(gridPos - vec2(step, 0.0))) / (2.0 * spacing.x);
+        float dz = (sampleHeight(gridPos + vec2(0.0, step)) - sampleHeight(gridPos - vec2(0.0, step))) / (2.0 * spacing.y);
+        normal = normalize(vec3(dx, -1.0, dz));
+        texCoord = gridPos / lastCell;
+    }
+
+    position.xz += tileOffset;
+
+    FragPos = vec3(M * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(M))) * normal; // Transform normals
+    TexCoord = texCoord; // Pass texture coordinates
     gl_Position = P * V * vec4(FragPos, 1.0);
 }
@@ -0,0 +1,377 @@
+//------------------------------------------------------------------------------
+// terrain-bake: headless batch generator.
+//
+// Generates the single mountain of every config and seed given on the command
+// line without a window or GL context, and writes heightmaps and meshes to
+// disk. Terrains are generated in parallel, each one optionally split across
+// threads of its own.
+//
+// Example: terrain-bake --seed-range=1:200 --jobs=16 --formats=pgm,tiles config.txt
+//------------------------------------------------------------------------------
+
+#include "config.h"
+#include "Heightfield.h"
+#include "TerrainMesh.h"
+#include "ThreadPool.h"
+#include "TileStore.h"
+
+#include <argh.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+	const char* Usage =
+		"Usage: terrain-bake [options] config.txt [more configs...]\n"
+		"  Bakes the single mountain, configs with world 1 are rejected\n"
+		"  --seeds=1,2,5       seeds to bake every config with, default the config's own\n"
+		"  --seed-range=1:100  seeds first to last, added to --seeds\n"
+		"  --out=bake          output directory\n"
+		"  --formats=pgm,obj   any of pgm (16-bit heightmap), raw (float32 heights),\n"
+		"                      obj (mesh with normals) and tiles (out/tilestore/, for config tileStore 1)\n"
+		"  --jobs=0            terrains generated at once, 0 = one per hardware thread\n"
+		"  --threads=1         threads per terrain\n";
+
+	struct BakeJob {
+		std::string name;   // output file name without extension
+		config cfg;
+	};
+
+	struct Formats {
+		bool pgm = false;
+		bool raw = false;
+		bool obj = false;
+		bool tiles = false;
+	};
+
+	std::vector<std::string> split(const std::string& list, char separator)
+	{
+		std::vector<std::string> parts;
+		std::stringstream stream(list);
+		std::string part;
+		while (std::getline(stream, part, separator)) {
+			if (!part.empty()) {
+				parts.push_back(part);
+			}
+		}
+		return parts;
+	}
+
+	// Whole text as an int, false for anything else
+	bool parseInt(const std::string& text, int& value)
+	{
+		const char* end = text.data() + text.size();
+		auto result = std::from_chars(text.data(), end, value);
+		return result.ec == std::errc() && result.ptr == end;
+	}
+
+	double seconds(std::chrono::high_resolution_clock::time_point since)
+	{
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - since;
+		return elapsed.count();
+	}
+
+	// 16-bit binary PGM across the terrain's height range, row 0 first
+	bool writePgm(const std::string& path, int size, const std::vector<float>& heights, glm::vec2 bounds)
+	{
+		std::ofstream out(path, std::ios::binary);
+		out << "P5\n" << size << " " << size << "\n65535\n";
+
+		float range = bounds.y - bounds.x;
+		std::vector<unsigned char> row((size_t)size * 2);
+		for (int r = 0; r < size; r++) {
+			for (int c = 0; c < size; c++) {
+				float h = range > 0.0f ? (heights[(size_t)r * size + c] - bounds.x) / range : 0.0f;
+				unsigned value = (unsigned)std::lround(std::min(std::max(h, 0.0f), 1.0f) * 65535.0f);
+				// PGM samples are big endian
+				row[c * 2 + 0] = (unsigned char)(value >> 8);
+				row[c * 2 + 1] = (unsigned char)(value & 0xff);
+			}
+			out.write(reinterpret_cast<const char*>(row.data()), (std::streamsize)row.size());
+		}
+		return (bool)out;
+	}
+
+	bool writeRaw(const std::string& path, const std::vector<float>& heights)
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(reinterpret_cast<const char*>(heights.data()), (std::streamsize)(heights.size() * sizeof(float)));
+		return (bool)out;
+	}
+
+	// Positions, texture coordinates and normals of the grid, with the
+	// triangles in the order mountain puts them in its index buffer
+	bool writeObj(const std::string& path, const HeightfieldSampler& sampler, const std::vector<float>& heights,
+		const std::vector<glm::vec3>& normals)
+	{
+		std::ofstream out(path, std::ios::binary);
+		int size = sampler.resolution();
+		int subdivisions = size - 1;
+
+		// Formatted into a buffer first, streams are slow one value at a time
+		std::string buffer;
+		char line[128];
+		auto flush = [&]() {
+			out.write(buffer.data(), (std::streamsize)buffer.size());
+			buffer.clear();
+		};
+
+		for (int row = 0; row < size; row++) {
+			for (int col = 0; col < size; col++) {
+				int n = std::snprintf(line, sizeof(line), "v %g %g %g\n",
+					sampler.gridX(col), heights[(size_t)row * size + col], sampler.gridZ(row));
+				buffer.append(line, n);
+			}
+			flush();
+		}
+		for (int row = 0; row < size; row++) {
+			for (int col = 0; col < size; col++) {
+				int n = std::snprintf(line, sizeof(line), "vt %g %g\n", col / (float)subdivisions, row / (float)subdivisions);
+				buffer.append(line, n);
+			}
+			flush();
+		}
+		for (const glm::vec3& normal : normals) {
+			int n = std::snprintf(line, sizeof(line), "vn %g %g %g\n", normal.x, normal.y, normal.z);
+			buffer.append(line, n);
+			if (buffer.size() > (1 << 20)) {
+				flush();
+			}
+		}
+		flush();
+
+		// OBJ indices start at 1
+		for (int row = 0; row < subdivisions; row++) {
+			for (int col = 0; col < subdivisions; col++) {
+				int i0 = row * size + col + 1;
+				int i1 = i0 + 1;
+				int i2 = i0 + size;
+				int i3 = i2 + 1;
+				int n = std::snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n",
+					i0, i0, i0, i1, i1, i1, i2, i2, i2,
+					i1, i1, i1, i3, i3, i3, i2, i2, i2);
+				buffer.append(line, n);
+			}
+			flush();
+		}
+		return (bool)out;
+	}
+
+	// Generates one terrain and writes it in every format. False when a file
+	// couldn't be written, log gets a line about the job either way.
+	bool bake(const BakeJob& job, const Formats& formats, const std::string& outDir, int threads, std::string& log)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		const config& cfg = job.cfg;
+		ThreadPool pool((unsigned)std::max(threads, 1));
+		HeightfieldSampler sampler(cfg);
+		int size = sampler.resolution();
+		size_t count = (size_t)size * size;
+
+		// Same heights as a CPU build in mountain, normals only when
+		// something is written with them
+		bool needsNormals = formats.obj || formats.tiles;
+		std::vector<float> heights(count);
+		std::vector<glm::vec3> normals(needsNormals ? count : 0);
+		if (needsNormals && cfg.normalMode == 3) {
+			pool.parallelFor(0, size, [&](int rowBegin, int rowEnd) {
+				std::vector<float> slopeX(size);
+				std::vector<float> slopeZ(size);
+				for (int row = rowBegin; row < rowEnd; row++) {
+					sampler.sampleRowGradient(row, 0, size, &heights[(size_t)row * size], slopeX.data(), slopeZ.data());
+					for (int col = 0; col < size; col++) {
+						normals[(size_t)row * size + col] = slopeNormal(slopeX[col], slopeZ[col]);
+					}
+				}
+			});
+		}
+		else {
+			pool.parallelFor(0, size, [&](int rowBegin, int rowEnd) {
+				for (int row = rowBegin; row < rowEnd; row++) {
+					sampler.sampleRow(row, 0, size, &heights[(size_t)row * size]);
+				}
+			});
+
+			if (needsNormals && cfg.normalMode == 2) {
+				centralDifferenceNormals(pool, cfg.subdivisions,
+					cfg.width / (float)cfg.subdivisions, cfg.height / (float)cfg.subdivisions,
+					heights.data(), normals.data());
+			}
+			else if (needsNormals) {
+				// Modes 0 and 1 give the same normals
+				gridNormals(pool, cfg.subdivisions, normals.data(), [&](int i) {
+					return glm::vec3(sampler.gridX(i % size), heights[i], sampler.gridZ(i / size));
+				});
+			}
+		}
+		auto range = std::minmax_element(heights.begin(), heights.end());
+		glm::vec2 bounds(*range.first, *range.second);
+		double generateTime = seconds(start);
+
+		auto writeStart = std::chrono::high_resolution_clock::now();
+		std::string base = (std::filesystem::path(outDir) / job.name).string();
+		std::string failed;
+		if (formats.pgm && !writePgm(base + ".pgm", size, heights, bounds)) {
+			failed += " pgm";
+		}
+		if (formats.raw && !writeRaw(base + ".raw", heights)) {
+			failed += " raw";
+		}
+		if (formats.obj && !writeObj(base + ".obj", sampler, heights, normals)) {
+			failed += " obj";
+		}
+		if (formats.tiles) {
+			TileData tile;
+			tile.heights = heights.data();
+			tile.normals = normals.data();
+			tile.bounds = bounds;
+			// Where the viewer looks for it, relative to outDir
+			TileStore store;
+			std::string path = (std::filesystem::path(outDir) / TileStore::pathFor(cfg)).string();
+			if (!store.save(path, cfg, { tile })) {
+				failed += " tiles";
+			}
+		}
+
+		std::ostringstream line;
+		line << job.name << ": " << size << " x " << size << ", generated in " << generateTime
+			<< " s, written in " << seconds(writeStart) << " s";
+		if (!failed.empty()) {
+			line << ", failed to write" << failed;
+		}
+		log = line.str();
+		return failed.empty();
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	// Options that take a value, so "-o dir" doesn't make dir a config path
+	argh::parser cmdl;
+	cmdl.add_params({ "-o", "--out", "--formats", "--seeds", "--seed-range", "-j", "--jobs", "--threads" });
+	cmdl.parse(argc, argv);
+	std::vector<std::string> configPaths(cmdl.pos_args().begin() + 1, cmdl.pos_args().end());
+	if (cmdl[{ "-h", "--help" }] || configPaths.empty()) {
+		std::cout << Usage;
+		return configPaths.empty() ? 1 : 0;
+	}
+
+	std::string outDir;
+	std::string formatList;
+	std::string seedList;
+	std::string seedRange;
+	int jobs = 0;
+	int threads = 1;
+	cmdl({ "-o", "--out" }, "bake") >> outDir;
+	cmdl("--formats", "pgm,obj") >> formatList;
+	cmdl("--seeds", "") >> seedList;
+	cmdl("--seed-range", "") >> seedRange;
+	cmdl({ "-j", "--jobs" }, 0) >> jobs;
+	cmdl("--threads", 1) >> threads;
+
+	Formats formats;
+	for (const std::string& format : split(formatList, ',')) {
+		if (format == "pgm") formats.pgm = true;
+		else if (format == "raw") formats.raw = true;
+		else if (format == "obj") formats.obj = true;
+		else if (format == "tiles") formats.tiles = true;
+		else {
+			std::cerr << "Error: Unknown format " << format << "\n" << Usage;
+			return 1;
+		}
+	}
+
+	std::vector<int> seeds;
+	for (const std::string& text : split(seedList, ',')) {
+		int seed = 0;
+		if (!parseInt(text, seed)) {
+			std::cerr << "Error: --seeds takes a list of integers, not " << text << "\n" << Usage;
+			return 1;
+		}
+		seeds.push_back(seed);
+	}
+	std::vector<std::string> rangeEnds = split(seedRange, ':');
+	int first = 0;
+	int last = 0;
+	if (rangeEnds.size() == 2 && parseInt(rangeEnds[0], first) && parseInt(rangeEnds[1], last)) {
+		// Counted in long long, last may be the largest int
+		for (long long seed = first; seed <= last; seed++) {
+			seeds.push_back((int)seed);
+		}
+	}
+	else if (!seedRange.empty()) {
+		std::cerr << "Error: --seed-range takes first:last\n" << Usage;
+		return 1;
+	}
+
+	// Every config with every seed, or its own seed without any
+	std::vector<BakeJob> bakeJobs;
+	for (const std::string& path : configPaths) {
+		if (!std::filesystem::exists(path)) {
+			std::cerr << "Error: Could not open config file: " << path << std::endl;
+			return 1;
+		}
+		config cfg = loadConfig(path);
+		// Its tiles would be keyed as world tiles but hold the falloff
+		// mountain, TileWorld would draw that in place of tile (0, 0)
+		if (cfg.world) {
+			std::cerr << "Error: " << path << " is a world 1 config, only the single mountain can be baked" << std::endl;
+			return 1;
+		}
+		std::string stem = std::filesystem::path(path).stem().string();
+		if (seeds.empty()) {
+			bakeJobs.push_back({ stem + "_s" + std::to_string(cfg.seed), cfg });
+		}
+		for (int seed : seeds) {
+			cfg.seed = seed;
+			bakeJobs.push_back({ stem + "_s" + std::to_string(seed), cfg });
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(outDir, error);
+	if (error) {
+		std::cerr << "Error: Could not create " << outDir << ": " << error.message() << std::endl;
+		return 1;
+	}
+
+	// One band of the pool per terrain, the terrains themselves may split
+	// further
+	auto start = std::chrono::high_resolution_clock::now();
+	std::mutex logMutex;
+	std::atomic<int> done(0);
+	std::atomic<int> failures(0);
+	ThreadPool pool((unsigned)std::max(jobs, 0));
+	pool.parallelFor(0, (int)bakeJobs.size(), [&](int first, int last) {
+		for (int i = first; i < last; i++) {
+			std::string log;
+			if (!bake(bakeJobs[i], formats, outDir, threads, log)) {
+				failures++;
+			}
+
+			std::lock_guard<std::mutex> lock(logMutex);
+			std::cout << "[" << ++done << "/" << bakeJobs.size() << "] " << log << "\n";
+		}
+	});
+
+	double total = seconds(start);
+	std::cout << "Baked " << bakeJobs.size() << " terrains in " << total << " s ("
+		<< (total > 0.0 ? bakeJobs.size() * 3600.0 / total : 0.0) << " per hour) with "
+		<< pool.size() << " jobs\n";
+	return failures > 0 ? 1 : 0;
+}
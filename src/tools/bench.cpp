@@ -0,0 +1,493 @@
+//------------------------------------------------------------------------------
+// terrain-bench: microbenchmarks of the terrain generation pipeline.
+//
+// Times every stage of a CPU build on its own (raw simplex noise, the ridged
+// multifractal, index generation, the normal paths, de-indexing into a
+// triangle soup) and the upload into GL buffers, swept over grid sizes,
+// octave counts and thread counts. Every case runs a few warmup repetitions
+// before the timed ones. Results go to JSON and CSV files that can be diffed
+// between commits.
+//
+// Example: terrain-bench --subdivisions=256,1024 --threads=1,8 --json=before.json
+//------------------------------------------------------------------------------
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "config.h"
+#include "Heightfield.h"
+#include "SimplexNoise.h"
+#include "TerrainMesh.h"
+#include "ThreadPool.h"
+
+#include <argh.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+	const char* Usage =
+		"Usage: terrain-bench [options]\n"
+		"  --subdivisions=256,512,1024,2048,4096,8192  grid sizes to sweep\n"
+		"  --octaves=1,4,8     octave counts for the ridged multifractal\n"
+		"  --threads=1,N       thread counts for the parallel stages, N = hardware threads\n"
+		"  --reps=5            timed repetitions per case\n"
+		"  --warmup=1          untimed repetitions before them\n"
+		"  --filter=normals    only cases whose name contains this\n"
+		"  --max-mb=4096       skip cases that would need more memory\n"
+		"  --label=name        stored with the results, e.g. the commit\n"
+		"  --json=file         write the results as JSON\n"
+		"  --csv=file          write the results as CSV\n"
+		"  --no-gpu            skip the upload cases, they need a GL context\n";
+
+	struct Options {
+		std::vector<int> subdivisions;
+		std::vector<int> octaves;
+		std::vector<int> threads;
+		int reps = 5;
+		int warmup = 1;
+		std::string filter;
+		size_t maxBytes = 0;
+	};
+
+	struct Result {
+		std::string name;
+		int subdivisions = 0;
+		int octaves = 0;
+		int threads = 0;
+		size_t items = 0;              // samples, indices or vertices per repetition
+		std::vector<double> seconds;   // one per timed repetition, sorted
+
+		double min() const { return seconds.front(); }
+		double median() const { return seconds[seconds.size() / 2]; }
+		double mean() const { return std::accumulate(seconds.begin(), seconds.end(), 0.0) / seconds.size(); }
+		double itemsPerSecond() const { return median() > 0.0 ? items / median() : 0.0; }
+	};
+
+	// Comma separated positive integers, N for the hardware threads. False
+	// for anything else.
+	bool parseList(const std::string& list, std::vector<int>& values)
+	{
+		values.clear();
+		std::stringstream stream(list);
+		std::string part;
+		while (std::getline(stream, part, ',')) {
+			if (part == "N") {
+				values.push_back((int)std::max(1u, std::thread::hardware_concurrency()));
+				continue;
+			}
+			int value = 0;
+			const char* end = part.data() + part.size();
+			auto result = std::from_chars(part.data(), end, value);
+			if (result.ec != std::errc() || result.ptr != end || value < 1) {
+				return false;
+			}
+			values.push_back(value);
+		}
+		// N may repeat one of the others
+		std::sort(values.begin(), values.end());
+		values.erase(std::unique(values.begin(), values.end()), values.end());
+		return !values.empty();
+	}
+
+	class Bench {
+
+	public:
+		explicit Bench(const Options& options) : options(options) {}
+
+		// Times fn unless the case is filtered out or needs more than bytes
+		// of memory. setup runs once before the repetitions, untimed.
+		void run(const std::string& name, int subdivisions, int octaves, int threads, size_t items, size_t bytes,
+			const std::function<void()>& setup, const std::function<void()>& fn)
+		{
+			if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+				return;
+			}
+			if (bytes > options.maxBytes) {
+				std::cout << name << " " << subdivisions << ": skipped, needs " << (bytes >> 20) << " MB\n";
+				return;
+			}
+
+			setup();
+			for (int i = 0; i < options.warmup; i++) {
+				fn();
+			}
+
+			Result result;
+			result.name = name;
+			result.subdivisions = subdivisions;
+			result.octaves = octaves;
+			result.threads = threads;
+			result.items = items;
+			for (int i = 0; i < std::max(options.reps, 1); i++) {
+				auto start = std::chrono::high_resolution_clock::now();
+				fn();
+				std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+				result.seconds.push_back(elapsed.count());
+			}
+			std::sort(result.seconds.begin(), result.seconds.end());
+
+			std::cout << name << " subdivisions " << subdivisions;
+			if (octaves > 0) {
+				std::cout << ", " << octaves << " octaves";
+			}
+			if (threads > 0) {
+				std::cout << ", " << threads << " threads";
+			}
+			std::cout << ": median " << result.median() * 1000.0 << " ms, min " << result.min() * 1000.0
+				<< " ms, " << result.itemsPerSecond() / 1e6 << " M/s\n";
+			results.push_back(result);
+		}
+
+		const std::vector<Result>& getResults() const { return results; }
+
+	private:
+		Options options;
+		std::vector<Result> results;
+	};
+
+	config benchConfig(int subdivisions, int octaves)
+	{
+		config cfg;
+		cfg.subdivisions = subdivisions;
+		cfg.octaves = (float)octaves;
+		return cfg;
+	}
+
+	// Hidden window for the upload cases, null when there is no display or
+	// no GL 3.3
+	GLFWwindow* createContext()
+	{
+		if (!glfwInit()) {
+			return nullptr;
+		}
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		GLFWwindow* window = glfwCreateWindow(64, 64, "terrain-bench", nullptr, nullptr);
+		if (!window) {
+			glfwTerminate();
+			return nullptr;
+		}
+		glfwMakeContextCurrent(window);
+		if (!gladLoadGL()) {
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return nullptr;
+		}
+		return window;
+	}
+
+	// Quoted and escaped for JSON, the label comes straight from the command
+	// line
+	std::string jsonString(const std::string& text)
+	{
+		std::string quoted = "\"";
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				quoted += '\\';
+				quoted += c;
+			}
+			else if ((unsigned char)c < 0x20) {
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+				quoted += escaped;
+			}
+			else {
+				quoted += c;
+			}
+		}
+		return quoted + "\"";
+	}
+
+	// Quoted for CSV (RFC 4180) with embedded quotes doubled, commas in the
+	// label don't shift the columns
+	std::string csvField(const std::string& text)
+	{
+		std::string quoted = "\"";
+		for (char c : text) {
+			if (c == '"') {
+				quoted += '"';
+			}
+			quoted += c;
+		}
+		return quoted + "\"";
+	}
+
+	void writeJson(const std::string& path, const std::string& label, const std::vector<Result>& results)
+	{
+		std::ofstream out(path);
+		out << "{\n  \"label\": " << jsonString(label) << ",\n"
+			<< "  \"simd\": \"" << SimplexNoise::simdLevelName(SimplexNoise::simdLevel()) << "\",\n"
+			<< "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n"
+			<< "  \"results\": [\n";
+		for (size_t i = 0; i < results.size(); i++) {
+			const Result& r = results[i];
+			out << "    { \"name\": " << jsonString(r.name) << ", \"subdivisions\": " << r.subdivisions
+				<< ", \"octaves\": " << r.octaves << ", \"threads\": " << r.threads
+				<< ", \"items\": " << r.items << ", \"reps\": " << r.seconds.size()
+				<< ", \"min\": " << r.min() << ", \"median\": " << r.median() << ", \"mean\": " << r.mean()
+				<< ", \"itemsPerSecond\": " << r.itemsPerSecond() << " }"
+				<< (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "  ]\n}\n";
+	}
+
+	void writeCsv(const std::string& path, const std::string& label, const std::vector<Result>& results)
+	{
+		std::ofstream out(path);
+		out << "label,name,subdivisions,octaves,threads,items,reps,min_s,median_s,mean_s,items_per_s\n";
+		for (const Result& r : results) {
+			out << csvField(label) << "," << csvField(r.name) << "," << r.subdivisions << "," << r.octaves << "," << r.threads
+				<< "," << r.items << "," << r.seconds.size() << "," << r.min() << "," << r.median()
+				<< "," << r.mean() << "," << r.itemsPerSecond() << "\n";
+		}
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	// Options that take a value, so "--threads 4" works like "--threads=4"
+	argh::parser cmdl;
+	cmdl.add_params({ "--subdivisions", "--octaves", "--threads", "--reps", "--warmup", "--filter", "--max-mb",
+		"--label", "--json", "--csv" });
+	cmdl.parse(argc, argv);
+	if (cmdl[{ "-h", "--help" }]) {
+		std::cout << Usage;
+		return 0;
+	}
+
+	Options options;
+	std::string subdivisionList;
+	std::string octaveList;
+	std::string threadList;
+	std::string label;
+	std::string jsonPath;
+	std::string csvPath;
+	int maxMB = 4096;
+	cmdl("--subdivisions", "256,512,1024,2048,4096,8192") >> subdivisionList;
+	cmdl("--octaves", "1,4,8") >> octaveList;
+	cmdl("--threads", "1,N") >> threadList;
+	cmdl("--reps", 5) >> options.reps;
+	cmdl("--warmup", 1) >> options.warmup;
+	cmdl("--filter", "") >> options.filter;
+	cmdl("--max-mb", 4096) >> maxMB;
+	cmdl("--label", "") >> label;
+	cmdl("--json", "") >> jsonPath;
+	cmdl("--csv", "") >> csvPath;
+	auto listError = [](const char* option, const std::string& list) {
+		std::cerr << "Error: " << option << " takes a list of positive integers, not " << list << "\n" << Usage;
+		return 1;
+	};
+	if (!parseList(subdivisionList, options.subdivisions)) {
+		return listError("--subdivisions", subdivisionList);
+	}
+	if (!parseList(octaveList, options.octaves)) {
+		return listError("--octaves", octaveList);
+	}
+	if (!parseList(threadList, options.threads)) {
+		return listError("--threads", threadList);
+	}
+	options.maxBytes = (size_t)std::max(maxMB, 0) * 1024 * 1024;
+
+	GLFWwindow* window = cmdl["--no-gpu"] ? nullptr : createContext();
+	if (!window && !cmdl["--no-gpu"]) {
+		std::cout << "No GL context, skipping the upload cases\n";
+	}
+	std::cout << "SIMD: " << SimplexNoise::simdLevelName(SimplexNoise::simdLevel())
+		<< ", " << std::thread::hardware_concurrency() << " hardware threads\n";
+
+	Bench bench(options);
+	for (int subdivisions : options.subdivisions) {
+		int size = subdivisions + 1;
+		size_t vertexCount = (size_t)size * size;
+		size_t indexCount = (size_t)subdivisions * subdivisions * 6;
+		config cfg = benchConfig(subdivisions, 6);
+
+		// Inputs shared by the cases of this grid size, made on demand
+		std::vector<float> xs;
+		std::vector<float> ys;
+		std::vector<float> heights;
+		std::vector<glm::vec3> verts;
+		std::vector<glm::vec3> normals;
+		std::vector<unsigned int> indices;
+		std::vector<float> noise;
+		auto makeCoords = [&]() {
+			if (!xs.empty()) {
+				return;
+			}
+			xs.resize(vertexCount);
+			ys.resize(vertexCount);
+			noise.resize(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++) {
+				xs[i] = (i % size) / (float)subdivisions * cfg.frequency;
+				ys[i] = (i / size) / (float)subdivisions * cfg.frequency;
+			}
+		};
+		auto makeMesh = [&]() {
+			if (!indices.empty()) {
+				return;
+			}
+			ThreadPool pool(0);
+			HeightfieldSampler sampler(cfg);
+			heights.resize(vertexCount);
+			verts.resize(vertexCount);
+			normals.resize(vertexCount);
+			indices.resize(indexCount);
+			for (int row = 0; row < size; row++) {
+				sampler.sampleRow(row, 0, size, &heights[(size_t)row * size]);
+				for (int col = 0; col < size; col++) {
+					size_t index = (size_t)row * size + col;
+					verts[index] = glm::vec3(sampler.gridX(col), heights[index], sampler.gridZ(row));
+				}
+			}
+			gridIndices(pool, subdivisions, indices.data());
+			scatterNormals(indices, normals, verts);
+		};
+		size_t coordBytes = vertexCount * 3 * sizeof(float);
+		size_t meshBytes = vertexCount * (sizeof(float) + 3 * sizeof(glm::vec3)) + indexCount * sizeof(unsigned int);
+
+		// Raw simplex noise, one sample per grid vertex
+		SimplexNoise simplex(cfg.seed);
+		bench.run("noise2D/scalar", subdivisions, 0, 1, vertexCount, coordBytes, makeCoords, [&]() {
+			for (size_t i = 0; i < vertexCount; i++) {
+				noise[i] = (float)simplex.noise2D(xs[i], ys[i]);
+			}
+		});
+		bench.run("noise2D/batch", subdivisions, 0, 1, vertexCount, coordBytes, makeCoords, [&]() {
+			simplex.noise2D(xs.data(), ys.data(), noise.data(), vertexCount);
+		});
+
+		// Final heights of the whole grid, as generateHeights() makes them
+		for (int octaves : options.octaves) {
+			for (int threads : options.threads) {
+				config octaveCfg = benchConfig(subdivisions, octaves);
+				std::vector<float> out;
+				std::unique_ptr<ThreadPool> pool;
+				bench.run("ridgedMF/rows", subdivisions, octaves, threads, vertexCount, vertexCount * sizeof(float),
+					[&]() {
+						out.resize(vertexCount);
+						pool = std::make_unique<ThreadPool>(threads);
+					},
+					[&]() {
+						HeightfieldSampler sampler(octaveCfg);
+						pool->parallelFor(0, size, [&](int rowBegin, int rowEnd) {
+							for (int row = rowBegin; row < rowEnd; row++) {
+								sampler.sampleRow(row, 0, size, &out[(size_t)row * size]);
+							}
+						});
+					});
+			}
+		}
+
+		for (int threads : options.threads) {
+			std::vector<unsigned int> out;
+			std::unique_ptr<ThreadPool> pool;
+			bench.run("indices", subdivisions, 0, threads, indexCount, indexCount * sizeof(unsigned int),
+				[&]() {
+					out.resize(indexCount);
+					pool = std::make_unique<ThreadPool>(threads);
+				},
+				[&]() { gridIndices(*pool, subdivisions, out.data()); });
+		}
+
+		// Normal paths, all from the same mesh
+		std::vector<glm::vec3> out;
+		bench.run("normals/scatter", subdivisions, 0, 1, vertexCount, meshBytes,
+			[&]() {
+				makeMesh();
+				out.resize(vertexCount);
+			},
+			[&]() { scatterNormals(indices, out, verts); });
+		for (int threads : options.threads) {
+			std::unique_ptr<ThreadPool> pool;
+			auto setup = [&]() {
+				makeMesh();
+				out.resize(vertexCount);
+				pool = std::make_unique<ThreadPool>(threads);
+			};
+			bench.run("normals/grid", subdivisions, 0, threads, vertexCount, meshBytes, setup, [&]() {
+				gridNormals(*pool, subdivisions, out.data(), [&](int i) { return verts[i]; });
+			});
+			bench.run("normals/central", subdivisions, 0, threads, vertexCount, meshBytes, setup, [&]() {
+				centralDifferenceNormals(*pool, subdivisions, cfg.width / (float)subdivisions,
+					cfg.height / (float)subdivisions, heights.data(), out.data());
+			});
+		}
+
+		// The triangle soup the terrain was drawn from before it was indexed
+		std::vector<glm::vec3> soupVerts;
+		std::vector<glm::vec3> soupNormals;
+		bench.run("deindex", subdivisions, 0, 1, indexCount, meshBytes + indexCount * 2 * sizeof(glm::vec3),
+			[&]() { makeMesh(); },
+			[&]() {
+				soupVerts.resize(indexCount);
+				soupNormals.resize(indexCount);
+				for (size_t i = 0; i < indexCount; i++) {
+					soupVerts[i] = verts[indices[i]];
+					soupNormals[i] = normals[indices[i]];
+				}
+			});
+		soupVerts = std::vector<glm::vec3>();
+		soupNormals = std::vector<glm::vec3>();
+
+		// Upload of vertexFormat 0 streams and of a vertexFormat 2 height
+		// texture, glFinish() so the transfer is part of the time
+		if (window) {
+			GLuint buffers[3];
+			GLuint texture;
+			glGenBuffers(3, buffers);
+			glGenTextures(1, &texture);
+			bench.run("upload/vertices", subdivisions, 0, 0, vertexCount, meshBytes, [&]() { makeMesh(); }, [&]() {
+				glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+				glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(glm::vec3), verts.data(), GL_STATIC_DRAW);
+				glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+				glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(glm::vec3), normals.data(), GL_STATIC_DRAW);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[2]);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+				glFinish();
+			});
+			bench.run("upload/heights", subdivisions, 0, 0, vertexCount, meshBytes, [&]() { makeMesh(); }, [&]() {
+				glBindTexture(GL_TEXTURE_2D, texture);
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, heights.data());
+				glFinish();
+			});
+			glDeleteTextures(1, &texture);
+			glDeleteBuffers(3, buffers);
+		}
+	}
+
+	if (!jsonPath.empty()) {
+		writeJson(jsonPath, label, bench.getResults());
+		std::cout << "Wrote " << jsonPath << "\n";
+	}
+	if (!csvPath.empty()) {
+		writeCsv(csvPath, label, bench.getResults());
+		std::cout << "Wrote " << csvPath << "\n";
+	}
+
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+	return 0;
+}